@@ -0,0 +1,111 @@
+#include "../src/pdf.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <leptonica/allheaders.h>
+#include <memory>
+#include <poppler-document.h>
+#include <string>
+#include <tesseract/baseapi.h>
+#include <vector>
+
+const char* ENGINE_LANGUAGE = "eng";
+
+double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void print_row(const char* mode, size_t pages, double init_ms, double total_ms)
+{
+    printf("%-12s %6zu %12.1f %14.1f %14.1f\n", mode, pages, init_ms,
+        init_ms / pages, total_ms / pages);
+}
+
+// The old worker loop: a new engine is created and initialized for every
+// page and deleted after it.
+int per_page_init(const std::vector<Pix*>& images)
+{
+    double init_ms = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (Pix* image : images) {
+        auto* api = new tesseract::TessBaseAPI();
+        auto init_start = std::chrono::steady_clock::now();
+        if (api->Init(nullptr, ENGINE_LANGUAGE) != 0) {
+            delete api;
+            return 0;
+        }
+        init_ms += elapsed_ms(init_start);
+        api->SetImage(image);
+        api->Recognize(nullptr);
+        delete api;
+    }
+    print_row("per-page", images.size(), init_ms, elapsed_ms(start));
+    return 1;
+}
+
+// The current worker loop: one engine, initialized once and reset with
+// Clear() between pages.
+int persistent(const std::vector<Pix*>& images)
+{
+    auto start = std::chrono::steady_clock::now();
+    tesseract::TessBaseAPI api;
+    if (api.Init(nullptr, ENGINE_LANGUAGE) != 0) {
+        return 0;
+    }
+    double init_ms = elapsed_ms(start);
+    for (Pix* image : images) {
+        api.SetImage(image);
+        api.Recognize(nullptr);
+        api.Clear();
+    }
+    print_row("persistent", images.size(), init_ms, elapsed_ms(start));
+    return 1;
+}
+
+// Compares the per-page cost of initializing an engine for every page with
+// keeping one engine per worker, on one thread over the first pages of a
+// PDF. The model comes from TESSDATA_PREFIX like in search_pdf.
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <pdf> [max pages]" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<poppler::document> doc(
+        poppler::document::load_from_file(argv[1]));
+    if (!doc) {
+        std::cerr << "Unable to open '" << argv[1] << "'." << std::endl;
+        return 1;
+    }
+    int max_pages = argc >= 3 ? atoi(argv[2]) : 10;
+    int num_pages = std::min(doc->pages(), std::max(1, max_pages));
+
+    RenderSettings settings;
+    settings.gray = true;
+    std::vector<Pix*> images;
+    for (int page_number = 1; page_number <= num_pages; page_number++) {
+        Pix* image = render_pdf_page(doc, page_number, settings, nullptr);
+        if (image == nullptr) {
+            return 1;
+        }
+        images.push_back(image);
+    }
+
+    printf("%-12s %6s %12s %14s %14s\n", "engine", "pages", "init ms",
+        "init ms/page", "total ms/page");
+    int status = per_page_init(images) && persistent(images) ? 0 : 1;
+    if (status != 0) {
+        std::cerr << "Failed to initialize the OCR engine." << std::endl;
+    }
+
+    for (Pix* image : images) {
+        pixDestroy(&image);
+    }
+    return status;
+}
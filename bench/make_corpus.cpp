@@ -0,0 +1,343 @@
+#include "../src/thirdparty/json.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <poppler-document.h>
+#include <poppler-image.h>
+#include <poppler-page-renderer.h>
+#include <poppler-page.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+using json = nlohmann::json;
+
+const int SCAN_DPI = 200;
+const double MARGIN = 54;
+const double LEADING = 14;
+
+typedef struct PageSize {
+    const char* name;
+    int width;
+    int height;
+} PageSize;
+
+const PageSize PAGE_SIZES[] = { { "letter", 612, 792 }, { "a4", 595, 842 },
+    { "legal", 612, 1008 } };
+
+const char* FILLER[] = { "policy", "insured", "coverage", "premium", "limit",
+    "endorsement", "form", "schedule", "liability", "property", "named",
+    "the", "of", "and", "to", "each", "occurrence", "aggregate", "deductible",
+    "effective", "date", "shown", "in", "declarations", "this", "section" };
+
+// Fixed-seed generator so every run writes byte-identical files.
+class Random {
+public:
+    explicit Random(uint64_t seed)
+        : state(seed)
+    {
+    }
+    uint32_t next()
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (uint32_t)(state >> 33);
+    }
+    int below(int n) { return (int)(next() % (uint32_t)n); }
+
+private:
+    uint64_t state;
+};
+
+typedef struct PlacedText {
+    std::string text;
+    double x;
+    double y;
+    double size;
+} PlacedText;
+
+typedef struct PageSpec {
+    PageSize size;
+    bool scanned;
+    std::vector<PlacedText> texts;
+    std::vector<std::string> codes;
+} PageSpec;
+
+class PdfWriter {
+public:
+    int reserve()
+    {
+        objects.emplace_back();
+        return (int)objects.size();
+    }
+    void set(int id, const std::string& body) { objects[id - 1] = body; }
+    int add(const std::string& body)
+    {
+        int id = reserve();
+        set(id, body);
+        return id;
+    }
+    std::string finish(int root) const
+    {
+        std::string out = "%PDF-1.4\n%\xE2\xE3\xCF\xD3\n";
+        std::vector<size_t> offsets;
+        for (size_t i = 0; i < objects.size(); i++) {
+            offsets.push_back(out.size());
+            out += std::to_string(i + 1) + " 0 obj\n" + objects[i]
+                + "\nendobj\n";
+        }
+
+        size_t xref = out.size();
+        out += "xref\n0 " + std::to_string(objects.size() + 1) + "\n";
+        out += "0000000000 65535 f \n";
+        for (size_t offset : offsets) {
+            char entry[21];
+            snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+            out += entry;
+        }
+        out += "trailer\n<< /Size " + std::to_string(objects.size() + 1)
+            + " /Root " + std::to_string(root) + " 0 R >>\nstartxref\n"
+            + std::to_string(xref) + "\n%%EOF\n";
+        return out;
+    }
+
+private:
+    std::vector<std::string> objects;
+};
+
+std::string stream_object(const std::string& data, const std::string& extra)
+{
+    return "<< /Length " + std::to_string(data.size()) + extra
+        + " >>\nstream\n" + data + "\nendstream";
+}
+
+std::string ref(int id) { return std::to_string(id) + " 0 R"; }
+
+std::string escape_text(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '(' || c == ')' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+std::string text_content(const PageSpec& spec)
+{
+    std::string content;
+    char position[64];
+    for (const PlacedText& text : spec.texts) {
+        snprintf(position, sizeof(position), "BT /F1 %.1f Tf %.2f %.2f Td (",
+            text.size, text.x, text.y);
+        content += position + escape_text(text.text) + ") Tj ET\n";
+    }
+    return content;
+}
+
+// Writes one PDF page per spec. Scanned pages use the matching entry of
+// images; without images every page is drawn as text.
+std::string build_pdf(const std::vector<PageSpec>& specs,
+    const std::vector<std::string>* images)
+{
+    PdfWriter writer;
+    int pages_id = writer.reserve();
+    int font_id = writer.add(
+        "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>");
+    std::string kids;
+
+    for (size_t i = 0; i < specs.size(); i++) {
+        const PageSpec& spec = specs[i];
+        std::string box = "[0 0 " + std::to_string(spec.size.width) + " "
+            + std::to_string(spec.size.height) + "]";
+        std::string resources, content;
+
+        if (images != nullptr && spec.scanned) {
+            int width = (spec.size.width * SCAN_DPI + 36) / 72;
+            int height = (spec.size.height * SCAN_DPI + 36) / 72;
+            int image_id = writer.add(stream_object((*images)[i],
+                " /Type /XObject /Subtype /Image /Width "
+                    + std::to_string(width) + " /Height "
+                    + std::to_string(height)
+                    + " /ColorSpace /DeviceGray /BitsPerComponent 8"
+                      " /Filter /FlateDecode"));
+            resources = "<< /XObject << /Im1 " + ref(image_id) + " >> >>";
+            content = "q " + std::to_string(spec.size.width) + " 0 0 "
+                + std::to_string(spec.size.height) + " 0 0 cm /Im1 Do Q\n";
+        } else {
+            resources = "<< /Font << /F1 " + ref(font_id) + " >> >>";
+            content = text_content(spec);
+        }
+
+        int content_id = writer.add(stream_object(content, ""));
+        int page_id = writer.add("<< /Type /Page /Parent " + ref(pages_id)
+            + " /MediaBox " + box + " /Resources " + resources
+            + " /Contents " + ref(content_id) + " >>");
+        kids += ref(page_id) + " ";
+    }
+
+    writer.set(pages_id,
+        "<< /Type /Pages /Kids [" + kids
+            + "] /Count " + std::to_string(specs.size()) + " >>");
+    int root = writer.add("<< /Type /Catalog /Pages " + ref(pages_id) + " >>");
+    return writer.finish(root);
+}
+
+// Renders the text version of a page and adds speckle noise, giving the
+// Flate-compressed 8-bit gray samples of a scanned page.
+int scan_page(const PageSpec& spec, Random& random, std::string& samples)
+{
+    std::vector<PageSpec> single(1, spec);
+    single[0].scanned = false;
+    std::string source = build_pdf(single, nullptr);
+    std::unique_ptr<poppler::document> doc(
+        poppler::document::load_from_raw_data(source.data(), source.size()));
+    if (!doc) {
+        return 0;
+    }
+    std::unique_ptr<poppler::page> page(doc->create_page(0));
+
+    poppler::page_renderer renderer;
+    renderer.set_render_hint(poppler::page_renderer::antialiasing, true);
+    renderer.set_render_hint(poppler::page_renderer::text_antialiasing, true);
+    renderer.set_image_format(poppler::image::format_gray8);
+    poppler::image image = renderer.render_page(page.get(), SCAN_DPI, SCAN_DPI);
+    if (!image.is_valid()) {
+        return 0;
+    }
+
+    int width = (spec.size.width * SCAN_DPI + 36) / 72;
+    int height = (spec.size.height * SCAN_DPI + 36) / 72;
+    std::vector<unsigned char> raw((size_t)width * height, 0xFF);
+    for (int y = 0; y < height && y < image.height(); y++) {
+        const char* row
+            = image.const_data() + (size_t)y * image.bytes_per_row();
+        memcpy(&raw[(size_t)y * width], row, std::min(width, image.width()));
+    }
+    for (size_t i = 0; i < raw.size(); i++) {
+        if (random.below(500) == 0) {
+            raw[i] = (unsigned char)random.below(256);
+        }
+    }
+
+    uLongf length = compressBound(raw.size());
+    samples.resize(length);
+    if (compress2((Bytef*)&samples[0], &length, raw.data(), raw.size(), 6)
+        != Z_OK) {
+        return 0;
+    }
+    samples.resize(length);
+    return 1;
+}
+
+// Places up to three codes, most in the header or footer band, on top of
+// filler body text.
+PageSpec make_page(const PageSize& size, bool scanned,
+    const std::vector<std::string>& codes, Random& random)
+{
+    PageSpec spec = { size, scanned, {}, {} };
+
+    for (double y = size.height - MARGIN - 60; y > MARGIN + 60; y -= LEADING) {
+        std::string line;
+        while (line.size() < 80) {
+            line += FILLER[random.below(sizeof(FILLER) / sizeof(*FILLER))];
+            line += " ";
+        }
+        spec.texts.push_back({ line, MARGIN, y, 10 });
+    }
+
+    int count = random.below(5) == 0 ? 0 : 1 + random.below(3);
+    for (int i = 0; i < count; i++) {
+        const std::string& code = codes[random.below((int)codes.size())];
+        double x = MARGIN + random.below(size.width / 2);
+        double y;
+        int band = random.below(5);
+        if (band < 2) {
+            y = size.height - MARGIN + 10 - random.below(20);
+        } else if (band < 4) {
+            y = MARGIN - 10 + random.below(20);
+        } else {
+            y = MARGIN + 80 + random.below(size.height - 2 * MARGIN - 160);
+            spec.texts.erase(std::remove_if(spec.texts.begin(),
+                                 spec.texts.end(),
+                                 [y](const PlacedText& text) {
+                                     return std::abs(text.y - y) < LEADING;
+                                 }),
+                spec.texts.end());
+        }
+        spec.texts.push_back({ code, x, y, 9.0 + random.below(3) });
+        spec.codes.push_back(code);
+    }
+
+    return spec;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <codes file> <output dir> [pages per file]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> codes;
+    std::ifstream codes_file(argv[1]);
+    std::string line;
+    while (std::getline(codes_file, line)) {
+        if (!line.empty()) {
+            codes.push_back(line);
+        }
+    }
+    if (codes.empty()) {
+        std::cerr << "No codes in '" << argv[1] << "'." << std::endl;
+        return 1;
+    }
+
+    int pages = argc >= 4 ? atoi(argv[3]) : 5;
+    std::filesystem::path out_dir(argv[2]);
+    std::filesystem::create_directories(out_dir);
+
+    Random random(20240601);
+    json truth = json::object();
+    const char* kinds[] = { "text", "scan", "mixed" };
+
+    for (const char* kind : kinds) {
+        for (const PageSize& size : PAGE_SIZES) {
+            std::vector<PageSpec> specs;
+            std::vector<std::string> images;
+            std::string name = std::string(kind) + "-" + size.name + ".pdf";
+            json& file_truth = truth[name];
+            file_truth = json::object();
+
+            for (int page = 0; page < pages; page++) {
+                bool scanned = strcmp(kind, "scan") == 0
+                    || (strcmp(kind, "mixed") == 0 && page % 2 == 1);
+                specs.push_back(make_page(size, scanned, codes, random));
+                images.emplace_back();
+                if (scanned
+                    && !scan_page(specs.back(), random, images.back())) {
+                    std::cerr << "Failed to scan page " << page + 1 << " of "
+                              << name << std::endl;
+                    return 1;
+                }
+                file_truth[std::to_string(page + 1)] = specs.back().codes;
+            }
+
+            std::ofstream file(out_dir / name, std::ios::binary);
+            file << build_pdf(specs, &images);
+            std::cerr << "Wrote " << (out_dir / name).string() << std::endl;
+        }
+    }
+
+    std::ofstream truth_file(out_dir / "truth.json");
+    truth_file << truth.dump(2) << std::endl;
+    return 0;
+}
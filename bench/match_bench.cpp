@@ -0,0 +1,243 @@
+#include "../src/matcher.hpp"
+#include "../src/thirdparty/json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+const size_t KEYWORD_COUNTS[] = { 10, 100, 1000, 10000, 100000 };
+const double MIN_SECONDS = 0.5;
+const double MAX_SECONDS = 5.0;
+
+// Reads OCR lines either from an OCR cache directory (*.ocr.json, as
+// written by --cache-dir) or from a text file with one line per line.
+int load_lines(const char* path, std::vector<std::string>& lines)
+{
+    std::error_code error;
+    if (fs::is_directory(path, error)) {
+        for (const auto& entry : fs::directory_iterator(path, error)) {
+            std::string name = entry.path().filename().string();
+            if (name.size() < 9
+                || name.compare(name.size() - 9, 9, ".ocr.json") != 0) {
+                continue;
+            }
+            std::ifstream file(entry.path());
+            json page = json::parse(file, nullptr, false);
+            if (page.is_discarded() || !page.contains("lines")) {
+                continue;
+            }
+            for (const json& line : page["lines"]) {
+                lines.push_back(line["text"].get<std::string>());
+            }
+        }
+    } else {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Unable to open '" << path << "'." << std::endl;
+            return 0;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            lines.push_back(line);
+        }
+    }
+
+    if (lines.empty()) {
+        std::cerr << "No OCR lines in '" << path << "'." << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+// The real codes first, then look-alike codes made by shifting each digit
+// and letter of a real code, until there are count distinct keywords.
+std::vector<std::string> make_keywords(
+    const std::vector<std::string>& codes, size_t count)
+{
+    std::vector<std::string> keywords;
+    std::set<std::string> seen;
+    uint64_t state = 88172645463325252ULL;
+
+    for (size_t i = 0; keywords.size() < count; i++) {
+        std::string keyword = codes[i % codes.size()];
+        if (i >= codes.size()) {
+            for (char& c : keyword) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                if (c >= '0' && c <= '9') {
+                    c = (char)('0' + (c - '0' + state % 10) % 10);
+                } else if (c >= 'A' && c <= 'Z') {
+                    c = (char)('A' + (c - 'A' + state % 26) % 26);
+                }
+            }
+        }
+        if (seen.insert(keyword).second) {
+            keywords.push_back(keyword);
+        }
+    }
+    return keywords;
+}
+
+// The matching loop search_pdf used before the automaton: one strstr pass
+// per keyword, collecting every occurrence.
+size_t strstr_matches(
+    const std::vector<std::string>& keywords, const char* text)
+{
+    size_t matches = 0;
+    for (const std::string& keyword : keywords) {
+        const char* found = strstr(text, keyword.c_str());
+        while (found != nullptr) {
+            matches++;
+            found = strstr(found + 1, keyword.c_str());
+        }
+    }
+    return matches;
+}
+
+// Mirrors process_line: exact occurrences, then approximate ones for
+// keywords without an exact hit.
+size_t matcher_matches(const KeywordMatcher& matcher, const char* text,
+    std::vector<KeywordMatch>& matches)
+{
+    matches.clear();
+    matcher.find_all(text, matches);
+    size_t exact = matches.size();
+    if (!matcher.approximate()) {
+        return exact;
+    }
+
+    matcher.find_approximate(text, matches);
+    size_t found = exact;
+    for (size_t i = exact; i < matches.size(); i++) {
+        if (std::none_of(matches.begin(), matches.begin() + exact,
+                [&](const KeywordMatch& other) {
+                    return other.keyword == matches[i].keyword;
+                })) {
+            found++;
+        }
+    }
+    return found;
+}
+
+// Runs match over the lines, in order and wrapping around, for at least
+// one full pass and MIN_SECONDS, but stops after MAX_SECONDS even inside a
+// pass.
+template <typename Match>
+void run(const char* name, size_t keyword_count, double build_ms,
+    const std::vector<std::string>& lines, Match match)
+{
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    size_t processed = 0, matches = 0;
+    double elapsed = 0;
+
+    while (true) {
+        matches += match(lines[processed % lines.size()].c_str());
+        processed++;
+        if (processed % 16 == 0 || processed % lines.size() == 0) {
+            elapsed = std::chrono::duration<double>(clock::now() - start)
+                          .count();
+            if (elapsed >= MAX_SECONDS
+                || (elapsed >= MIN_SECONDS && processed >= lines.size())) {
+                break;
+            }
+        }
+    }
+
+    printf("%9zu  %-12s %10.1f %12.0f %12.1f %10.3f\n", keyword_count, name,
+        build_ms, processed / elapsed, elapsed * 1e9 / processed,
+        (double)matches / processed);
+    fflush(stdout);
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <codes file> <OCR cache dir | lines file>"
+                     " [max keywords]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> codes;
+    std::ifstream codes_file(argv[1]);
+    std::string code;
+    while (std::getline(codes_file, code)) {
+        if (!code.empty()) {
+            codes.push_back(code);
+        }
+    }
+    if (codes.empty()) {
+        std::cerr << "No codes in '" << argv[1] << "'." << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> lines;
+    if (!load_lines(argv[2], lines)) {
+        return 1;
+    }
+    size_t max_keywords = argc >= 4 ? strtoul(argv[3], nullptr, 10) : 100000;
+
+    size_t bytes = 0;
+    for (const std::string& line : lines) {
+        bytes += line.size();
+    }
+    printf("%zu lines, %.1f bytes per line\n", lines.size(),
+        (double)bytes / lines.size());
+    printf("%9s  %-12s %10s %12s %12s %10s\n", "keywords", "matcher",
+        "build ms", "lines/sec", "ns/line", "hits/line");
+
+    std::vector<KeywordMatch> matches;
+    for (size_t count : KEYWORD_COUNTS) {
+        if (count > max_keywords) {
+            break;
+        }
+        std::vector<std::string> keywords = make_keywords(codes, count);
+
+        run("strstr", count, 0, lines, [&](const char* text) {
+            return strstr_matches(keywords, text);
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        KeywordMatcher exact(keywords);
+        double build_ms = elapsed_ms(start);
+        run("automaton", count, build_ms, lines, [&](const char* text) {
+            return matcher_matches(exact, text, matches);
+        });
+
+        start = std::chrono::steady_clock::now();
+        KeywordMatcher normalized(keywords, {}, true);
+        build_ms = elapsed_ms(start);
+        run("normalize", count, build_ms, lines, [&](const char* text) {
+            return matcher_matches(normalized, text, matches);
+        });
+
+        start = std::chrono::steady_clock::now();
+        KeywordMatcher approximate(
+            keywords, std::vector<int>(keywords.size(), 1));
+        build_ms = elapsed_ms(start);
+        run("distance=1", count, build_ms, lines, [&](const char* text) {
+            return matcher_matches(approximate, text, matches);
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+#!/bin/bash
+# Usage: bench/run.sh [pages per file] [threads]
+#
+# Generates the synthetic corpus under bench/out and times ./search_pdf over
+# it in several configurations, summarizing each run.
+
+cd "$(dirname "$0")/.."
+
+PAGES=${1:-5}
+THREADS=${2:-auto}
+OUT=bench/out
+
+if [ ! -x ./search_pdf ]; then
+    echo "Build search_pdf first (make build or make static)."
+    exit 1
+fi
+
+mkdir -p $OUT
+bench/make_corpus codes.txt $OUT/corpus $PAGES || exit 1
+ls $OUT/corpus/*.pdf > $OUT/manifest.txt
+
+run() {
+    LABEL=$1
+    shift
+    START=`date +%s%N`
+    ./search_pdf --batch --stream --timings "$@" $OUT/manifest.txt codes.txt \
+        all $THREADS > $OUT/$LABEL.out 2> $OUT/$LABEL.err
+    STATUS=$?
+    END=`date +%s%N`
+    bench/summarize $LABEL $OUT/$LABEL.out $OUT/$LABEL.err \
+        $OUT/corpus/truth.json
+    echo "  wall: $(( (END - START) / 1000000 )) ms including startup," \
+        "exit status $STATUS"
+}
+
+rm -rf $OUT/cache
+run ocr
+run gray --gray
+run text-layer --text-layer
+run staged --gray --render-threads=$(( (`nproc` + 3) / 4 ))
+run coarse --gray --coarse-dpi=150
+run split --gray --split-page=4
+run cache-cold --gray --cache-dir=$OUT/cache
+run cache-warm --gray --cache-dir=$OUT/cache
+
+# Engine start-up per page, with one engine per page against one per worker.
+if [ -x bench/init_bench ]; then
+    echo "init: first $PAGES pages of $(head -n 1 $OUT/manifest.txt)"
+    bench/init_bench "$(head -n 1 $OUT/manifest.txt)" $PAGES
+fi
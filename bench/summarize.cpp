@@ -0,0 +1,176 @@
+#include "../src/thirdparty/json.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Nearest-rank percentile of already sorted samples.
+double percentile(const std::vector<double>& samples, double fraction)
+{
+    size_t index = (size_t)(fraction * (samples.size() - 1) + 0.5);
+    return samples[index];
+}
+
+std::string base_name(const std::string& path)
+{
+    auto slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Reads the streamed page results, one JSON object per line.
+int read_pages(const char* path, std::vector<json>& pages)
+{
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Unable to open '" << path << "'." << std::endl;
+        return 0;
+    }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        json page = json::parse(line, nullptr, false);
+        if (page.is_discarded()) {
+            std::cerr << "Skipping malformed result line." << std::endl;
+            continue;
+        }
+        pages.push_back(std::move(page));
+    }
+    return 1;
+}
+
+// Picks the run summary out of the --timings diagnostics on stderr.
+json read_summary(const char* path)
+{
+    std::ifstream in(path);
+    std::string line;
+    json summary;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] != '{') {
+            continue;
+        }
+        json report = json::parse(line, nullptr, false);
+        if (!report.is_discarded() && report.contains("makespanMs")) {
+            summary = std::move(report);
+        }
+    }
+    return summary;
+}
+
+void print_latencies(const std::vector<json>& pages)
+{
+    std::map<std::string, std::vector<double>> stages;
+    for (const json& page : pages) {
+        if (!page.contains("timings")) {
+            continue;
+        }
+        double total = 0;
+        for (const auto& stage : page["timings"].items()) {
+            stages[stage.key()].push_back(stage.value().get<double>());
+            total += stage.value().get<double>();
+        }
+        stages["(page)"].push_back(total);
+    }
+
+    printf("  %-16s %6s %10s %10s %10s %10s\n", "stage (ms)", "pages", "p50",
+        "p90", "p99", "max");
+    for (auto& stage : stages) {
+        std::vector<double>& samples = stage.second;
+        std::sort(samples.begin(), samples.end());
+        printf("  %-16s %6zu %10.1f %10.1f %10.1f %10.1f\n",
+            stage.first.c_str(), samples.size(), percentile(samples, 0.5),
+            percentile(samples, 0.9), percentile(samples, 0.99),
+            samples.back());
+    }
+}
+
+void print_recall(const std::vector<json>& pages, const json& truth)
+{
+    std::map<std::string, const json*> results;
+    for (const json& page : pages) {
+        std::string key = base_name(page.value("file", std::string()))
+            + ":" + std::to_string(page["pageNumber"].get<int>());
+        results[key] = &page;
+    }
+
+    size_t expected = 0, found = 0, unexpected = 0;
+    for (const auto& file : truth.items()) {
+        for (const auto& page : file.value().items()) {
+            auto result = results.find(file.key() + ":" + page.key());
+            if (result == results.end()) {
+                continue;
+            }
+
+            std::set<std::string> codes;
+            for (const auto& code : page.value()) {
+                codes.insert(code.get<std::string>());
+            }
+            expected += codes.size();
+
+            const json& page_result = *result->second;
+            if (!page_result.contains("found")) {
+                continue;
+            }
+            for (const auto& keyword : page_result["found"].items()) {
+                if (codes.count(keyword.key())) {
+                    found++;
+                } else {
+                    unexpected++;
+                }
+            }
+        }
+    }
+
+    printf("  recall: %zu/%zu planted codes found (%.1f%%), %zu other "
+           "keywords reported\n",
+        found, expected, expected ? 100.0 * found / expected : 100.0,
+        unexpected);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <label> <results file> <diagnostics file>"
+                     " [truth.json]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<json> pages;
+    if (!read_pages(argv[2], pages)) {
+        return 1;
+    }
+    json summary = read_summary(argv[3]);
+    if (summary.is_null()) {
+        std::cerr << "No --timings summary in '" << argv[3] << "'."
+                  << std::endl;
+        return 1;
+    }
+
+    double makespan_ms = summary["makespanMs"].get<double>();
+    printf("== %s ==\n", argv[1]);
+    printf("  pages: %zu in %.1f ms, %.2f pages/sec\n", pages.size(),
+        makespan_ms, pages.size() * 1000.0 / makespan_ms);
+    printf("  peak RSS: %ld kB\n", summary["peakRssKb"].get<long>());
+    print_latencies(pages);
+
+    if (argc >= 5) {
+        std::ifstream truth_file(argv[4]);
+        json truth = json::parse(truth_file, nullptr, false);
+        if (truth.is_discarded()) {
+            std::cerr << "Unable to parse '" << argv[4] << "'." << std::endl;
+            return 1;
+        }
+        print_recall(pages, truth);
+    }
+    return 0;
+}
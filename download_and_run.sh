@@ -9,7 +9,7 @@ elif [ "$KEY" = "" ]; then
     echo "Missing key"
 else
     FILENAME=/tmp/`basename $KEY`
-    wget -O $FILENAME $URL && ./search_pdf "$FILENAME" codes.txt all `nproc --all`
+    wget -O $FILENAME $URL && ./search_pdf "$FILENAME" codes.txt all auto
     rm $FILENAME
 fi
 
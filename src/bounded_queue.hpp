@@ -0,0 +1,90 @@
+#ifndef OCR_DEV_BOUNDED_QUEUE_HPP
+#define OCR_DEV_BOUNDED_QUEUE_HPP
+#include <cstddef>
+#include <deque>
+#include <pthread.h>
+
+// Blocking FIFO shared between pipeline stages. push() waits while the
+// queue is full so producers cannot run ahead of consumers; once closed,
+// push() fails and pop() drains what is left before failing. try_pop()
+// never waits.
+template <typename T> class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity(capacity > 0 ? capacity : 1)
+    {
+        pthread_mutex_init(&lock, nullptr);
+        pthread_cond_init(&not_empty, nullptr);
+        pthread_cond_init(&not_full, nullptr);
+    }
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+    ~BoundedQueue()
+    {
+        pthread_cond_destroy(&not_full);
+        pthread_cond_destroy(&not_empty);
+        pthread_mutex_destroy(&lock);
+    }
+
+    bool push(const T& item)
+    {
+        pthread_mutex_lock(&lock);
+        while (!closed && items.size() >= capacity) {
+            pthread_cond_wait(&not_full, &lock);
+        }
+        bool accepted = !closed;
+        if (accepted) {
+            items.push_back(item);
+            pthread_cond_signal(&not_empty);
+        }
+        pthread_mutex_unlock(&lock);
+        return accepted;
+    }
+
+    bool pop(T& item)
+    {
+        pthread_mutex_lock(&lock);
+        while (!closed && items.empty()) {
+            pthread_cond_wait(&not_empty, &lock);
+        }
+        bool available = !items.empty();
+        if (available) {
+            item = items.front();
+            items.pop_front();
+            pthread_cond_signal(&not_full);
+        }
+        pthread_mutex_unlock(&lock);
+        return available;
+    }
+
+    bool try_pop(T& item)
+    {
+        pthread_mutex_lock(&lock);
+        bool available = !items.empty();
+        if (available) {
+            item = items.front();
+            items.pop_front();
+            pthread_cond_signal(&not_full);
+        }
+        pthread_mutex_unlock(&lock);
+        return available;
+    }
+
+    void close()
+    {
+        pthread_mutex_lock(&lock);
+        closed = true;
+        pthread_cond_broadcast(&not_empty);
+        pthread_cond_broadcast(&not_full);
+        pthread_mutex_unlock(&lock);
+    }
+
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+};
+#endif // OCR_DEV_BOUNDED_QUEUE_HPP
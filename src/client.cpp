@@ -0,0 +1,165 @@
+#include "thirdparty/json.hpp"
+#include "util.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+using json = nlohmann::json;
+
+void print_usage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " [--send-bytes] [--keywords=FILE] <socket> <path to pdf>"
+                 " [page num]"
+              << std::endl
+              << "       " << program << " --shutdown <socket>" << std::endl;
+}
+
+int read_lines(const char* path, std::vector<std::string>& lines)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+
+    return 1;
+}
+
+int connect_socket(const char* path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long." << std::endl;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        std::cerr << "Failed to connect to '" << path
+                  << "': " << strerror(errno) << std::endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    return fd;
+}
+
+int exchange(int fd, const std::string& request, std::string& response)
+{
+    size_t sent = 0;
+    while (sent < request.size()) {
+        ssize_t n = send(fd, request.data() + sent, request.size() - sent,
+            MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return 0;
+        }
+        sent += n;
+    }
+
+    char chunk[65536];
+    while (response.empty() || response.back() != '\n') {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return 0;
+        }
+        response.append(chunk, n);
+    }
+
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    bool send_bytes = false;
+    bool shutdown = false;
+    const char* keyword_file = nullptr;
+    std::vector<char*> positional;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--send-bytes") == 0) {
+            send_bytes = true;
+        } else if (strcmp(argv[i], "--shutdown") == 0) {
+            shutdown = true;
+        } else if (strncmp(argv[i], "--keywords=", 11) == 0) {
+            keyword_file = argv[i] + 11;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    if (positional.empty() || (!shutdown && positional.size() < 2)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    json request = json::object();
+    if (shutdown) {
+        request["shutdown"] = true;
+    } else {
+        if (send_bytes) {
+            MappedFile file;
+            if (!file.open(positional[1])) {
+                return 1;
+            }
+            std::string encoded;
+            base64_encode(file.data(), file.size(), encoded);
+            request["pdfBase64"] = encoded;
+            request["name"] = positional[1];
+        } else {
+            // The server resolves paths against its own working directory.
+            request["pdf"] = std::filesystem::absolute(positional[1]).string();
+        }
+        if (positional.size() >= 3) {
+            request["pages"] = positional[2];
+        }
+        if (keyword_file) {
+            std::vector<std::string> keywords;
+            if (!read_lines(keyword_file, keywords)) {
+                std::cerr << "Failed to open keywords file." << std::endl;
+                return 1;
+            }
+            request["keywords"] = keywords;
+        }
+    }
+
+    int fd = connect_socket(positional[0]);
+    if (fd < 0) {
+        return 1;
+    }
+
+    std::string response;
+    int ok = exchange(fd, request.dump() + "\n", response);
+    close(fd);
+    if (!ok) {
+        std::cerr << "Connection closed before a response arrived."
+                  << std::endl;
+        return 1;
+    }
+
+    std::cout << response;
+    json parsed = json::parse(response, nullptr, false);
+    return parsed.is_object() && parsed.contains("error") ? 1 : 0;
+}
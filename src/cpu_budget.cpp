@@ -0,0 +1,169 @@
+#include "cpu_budget.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+static const char* OMP_LIMIT_MARKER = "SEARCH_PDF_OMP_THREAD_LIMIT";
+
+// CPUs granted by the quota files in one cgroup directory, or 0 when it
+// sets no limit.
+static long read_quota(const std::string& dir, bool v2)
+{
+    long quota = 0, period = 0;
+    if (v2) {
+        std::ifstream file(dir + "/cpu.max");
+        std::string max;
+        if (!(file >> max >> period) || max == "max") {
+            return 0;
+        }
+        quota = strtol(max.c_str(), nullptr, 10);
+    } else {
+        std::ifstream quota_file(dir + "/cpu.cfs_quota_us");
+        std::ifstream period_file(dir + "/cpu.cfs_period_us");
+        if (!(quota_file >> quota) || !(period_file >> period)) {
+            return 0;
+        }
+    }
+
+    if (quota <= 0 || period <= 0) {
+        return 0;
+    }
+    return std::max(1L, (quota + period - 1) / period);
+}
+
+static long tighter_limit(long limit, long other)
+{
+    if (limit == 0) {
+        return other;
+    }
+    return other == 0 ? limit : std::min(limit, other);
+}
+
+// Walks from the process's cgroup up to the mount point. Inside a
+// container the host path from /proc/self/cgroup usually does not exist
+// below the mount, which then holds the container's own limit.
+static long hierarchy_limit(
+    const std::string& mount, const std::string& path, bool v2)
+{
+    std::string dir = mount + path;
+    while (dir.size() > mount.size() && dir.back() == '/') {
+        dir.pop_back();
+    }
+
+    long limit = 0;
+    while (true) {
+        limit = tighter_limit(limit, read_quota(dir, v2));
+        if (dir.size() <= mount.size()) {
+            break;
+        }
+        dir.erase(dir.rfind('/'));
+    }
+    return limit;
+}
+
+static bool has_cpu_controller(const std::string& controllers)
+{
+    std::istringstream list(controllers);
+    std::string controller;
+    while (std::getline(list, controller, ',')) {
+        if (controller == "cpu") {
+            return true;
+        }
+    }
+    return false;
+}
+
+static long cgroup_cpu_limit()
+{
+    const char* v1_mounts[]
+        = { "/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu" };
+    std::ifstream file("/proc/self/cgroup");
+    std::string line;
+    long limit = 0;
+
+    while (std::getline(file, line)) {
+        auto first = line.find(':');
+        auto second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+
+        if (controllers.empty()) {
+            limit = tighter_limit(
+                limit, hierarchy_limit("/sys/fs/cgroup", path, true));
+        } else if (has_cpu_controller(controllers)) {
+            for (const char* mount : v1_mounts) {
+                if (access(mount, F_OK) == 0) {
+                    limit = tighter_limit(
+                        limit, hierarchy_limit(mount, path, false));
+                    break;
+                }
+            }
+        }
+    }
+    return limit;
+}
+
+long available_cpus()
+{
+    long cpus = 0;
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        cpus = CPU_COUNT(&set);
+    }
+    if (cpus <= 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    return std::max(1L, tighter_limit(cpus, cgroup_cpu_limit()));
+}
+
+void split_cpu_budget(long cpus, long pages, long& workers, long& omp_threads)
+{
+    if (pages >= cpus) {
+        workers = cpus;
+        omp_threads = 1;
+    } else {
+        workers = std::max(1L, pages);
+        omp_threads = std::min(MAX_OMP_THREADS, cpus / workers);
+    }
+}
+
+long current_omp_limit()
+{
+    const char* limit = getenv("OMP_THREAD_LIMIT");
+    return limit == nullptr ? 0 : std::max(0L, strtol(limit, nullptr, 10));
+}
+
+long user_omp_limit()
+{
+    const char* limit = getenv("OMP_THREAD_LIMIT");
+    const char* marker = getenv(OMP_LIMIT_MARKER);
+    if (limit == nullptr
+        || (marker != nullptr && strcmp(limit, marker) == 0)) {
+        return 0;
+    }
+    return current_omp_limit();
+}
+
+void reexec_with_omp_limit(char** argv, long omp_threads)
+{
+    std::string limit = std::to_string(omp_threads);
+    setenv("OMP_THREAD_LIMIT", limit.c_str(), 1);
+    setenv(OMP_LIMIT_MARKER, limit.c_str(), 1);
+    std::cout.flush();
+    std::cerr.flush();
+
+    execv("/proc/self/exe", argv);
+    std::cerr << "Unable to restart with OMP_THREAD_LIMIT=" << limit << ": "
+              << strerror(errno) << std::endl;
+}
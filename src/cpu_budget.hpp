@@ -0,0 +1,26 @@
+#ifndef OCR_DEV_CPU_BUDGET_HPP
+#define OCR_DEV_CPU_BUDGET_HPP
+
+// Tesseract's LSTM splits a page over at most four OpenMP threads.
+const long MAX_OMP_THREADS = 4;
+
+// CPUs the process may use: its affinity mask, capped by any cgroup v2
+// cpu.max or v1 CFS quota from its own cgroup up to the hierarchy root.
+long available_cpus();
+
+// Splits cpus between page workers and OpenMP threads per engine. With at
+// least as many pages as cpus each worker runs single threaded; with fewer
+// pages the spare cpus go to each page's engine, up to MAX_OMP_THREADS.
+void split_cpu_budget(long cpus, long pages, long& workers, long& omp_threads);
+
+// OMP_THREAD_LIMIT as set by the user, or 0 when it is unset or was set by
+// reexec_with_omp_limit().
+long user_omp_limit();
+
+// OMP_THREAD_LIMIT in effect for this process, or 0 when unset.
+long current_omp_limit();
+
+// The OpenMP runtime reads OMP_THREAD_LIMIT once at startup, so a new
+// limit needs a fresh process image. Only returns if execv fails.
+void reexec_with_omp_limit(char** argv, long omp_threads);
+#endif // OCR_DEV_CPU_BUDGET_HPP
@@ -0,0 +1,63 @@
+#include "early_exit.hpp"
+#include "thirdparty/json.hpp"
+#include <algorithm>
+#include <limits>
+#include <pthread.h>
+
+using json = nlohmann::json;
+
+EarlyExit::EarlyExit(ExitMode mode, size_t documents, size_t keywords)
+    : mode(mode)
+    , keywords(keywords)
+    , limits(documents)
+    , first_seen(mode == AllFound ? documents : 0)
+    , skipped(0)
+{
+    for (auto& limit : limits) {
+        limit = std::numeric_limits<long>::max();
+    }
+    pthread_mutex_init(&lock, nullptr);
+}
+
+EarlyExit::~EarlyExit() { pthread_mutex_destroy(&lock); }
+
+bool EarlyExit::cancelled(int document, long sequence) const
+{
+    return mode != ScanAll
+        && sequence > limits[document].load(std::memory_order_relaxed);
+}
+
+void EarlyExit::record(int document, long sequence, const json& result)
+{
+    if (mode == ScanAll || !result.contains("found")) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    if (mode == FirstMatch) {
+        if (sequence < limits[document]) {
+            limits[document] = sequence;
+        }
+    } else {
+        std::map<std::string, long>& seen = first_seen[document];
+        for (const auto& keyword : result["found"].items()) {
+            auto it = seen.find(keyword.key());
+            if (it == seen.end()) {
+                seen[keyword.key()] = sequence;
+            } else if (sequence < it->second) {
+                it->second = sequence;
+            }
+        }
+
+        if (seen.size() >= keywords) {
+            long limit = 0;
+            for (const auto& keyword : seen) {
+                limit = std::max(limit, keyword.second);
+            }
+            limits[document] = limit;
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+}
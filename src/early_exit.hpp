@@ -0,0 +1,35 @@
+#ifndef OCR_DEV_EARLY_EXIT_HPP
+#define OCR_DEV_EARLY_EXIT_HPP
+#include "options.hpp"
+#include "thirdparty/json.hpp"
+#include <atomic>
+#include <map>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+// Decides, per document, the last page sequence that still has to be
+// scanned. FirstMatch stops after the earliest page with any hit;
+// AllFound stops once every keyword has been seen, at the latest of the
+// earliest pages each keyword appears on. Pages past the limit are
+// cancelled, including ones already being recognized.
+class EarlyExit {
+public:
+    EarlyExit(ExitMode mode, size_t documents, size_t keywords);
+    EarlyExit(const EarlyExit&) = delete;
+    EarlyExit& operator=(const EarlyExit&) = delete;
+    ~EarlyExit();
+    bool cancelled(int document, long sequence) const;
+    void record(int document, long sequence, const nlohmann::json& result);
+    void count_skipped() { skipped++; }
+    long skipped_pages() const { return skipped; }
+
+private:
+    ExitMode mode;
+    size_t keywords;
+    std::vector<std::atomic<long> > limits;
+    std::vector<std::map<std::string, long> > first_seen;
+    std::atomic<long> skipped;
+    pthread_mutex_t lock;
+};
+#endif // OCR_DEV_EARLY_EXIT_HPP
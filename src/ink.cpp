@@ -0,0 +1,96 @@
+#include "ink.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <leptonica/allheaders.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Same weights as the ARGB to gray conversion in pdf.cpp, kept in 8.8
+// fixed point: luma < INK_LEVEL once rounded.
+const uint32_t INK_WEIGHTED_LIMIT = (INK_LEVEL << 8) - 128;
+
+static inline bool rgba_is_ink(l_uint32 pixel)
+{
+    l_uint32 r = pixel >> 24;
+    l_uint32 g = (pixel >> 16) & 0xff;
+    l_uint32 b = (pixel >> 8) & 0xff;
+    return 77 * r + 150 * g + 29 * b < INK_WEIGHTED_LIMIT;
+}
+
+// Counts ink in 8 bpp bytes. Byte order inside Leptonica's words does not
+// matter for a count, so whole words are scanned as plain bytes.
+static size_t count_gray_bytes(const unsigned char* bytes, size_t size)
+{
+    size_t ink = 0, i = 0;
+#ifdef __SSE2__
+    const __m128i flip = _mm_set1_epi8((char)0x80);
+    const __m128i level = _mm_set1_epi8((char)(INK_LEVEL ^ 0x80));
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(bytes + i));
+        __m128i dark = _mm_cmplt_epi8(_mm_xor_si128(v, flip), level);
+        ink += __builtin_popcount(_mm_movemask_epi8(dark));
+    }
+#endif
+    for (; i < size; i++) {
+        ink += bytes[i] < INK_LEVEL;
+    }
+    return ink;
+}
+
+static size_t count_rgba_words(const l_uint32* words, size_t size)
+{
+    size_t ink = 0, i = 0;
+#ifdef __SSE2__
+    // r and g land in the two 16-bit halves of each lane, so one madd
+    // weighs both; b gets its own.
+    const __m128i rg_weights = _mm_set1_epi32(77 | (150 << 16));
+    const __m128i b_weight = _mm_set1_epi32(29);
+    const __m128i byte = _mm_set1_epi32(0xff);
+    const __m128i g_mask = _mm_set1_epi32(0x00ff0000);
+    const __m128i limit = _mm_set1_epi32((int)INK_WEIGHTED_LIMIT);
+    for (; i + 4 <= size; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(words + i));
+        __m128i rg = _mm_or_si128(
+            _mm_srli_epi32(v, 24), _mm_and_si128(v, g_mask));
+        __m128i b = _mm_and_si128(_mm_srli_epi32(v, 8), byte);
+        __m128i luma = _mm_add_epi32(_mm_madd_epi16(rg, rg_weights),
+            _mm_madd_epi16(b, b_weight));
+        __m128i dark = _mm_cmplt_epi32(luma, limit);
+        ink += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(dark)));
+    }
+#endif
+    for (; i < size; i++) {
+        ink += rgba_is_ink(words[i]);
+    }
+    return ink;
+}
+
+double ink_ratio(Pix* image)
+{
+    int width = pixGetWidth(image);
+    int height = pixGetHeight(image);
+    int depth = pixGetDepth(image);
+    int wpl = pixGetWpl(image);
+    l_uint32* data = pixGetData(image);
+    if ((depth != 8 && depth != 32) || width <= 0 || height <= 0) {
+        return -1;
+    }
+
+    size_t ink = 0;
+    for (int y = 0; y < height; y++) {
+        l_uint32* line = data + (size_t)y * wpl;
+        if (depth == 32) {
+            ink += count_rgba_words(line, width);
+            continue;
+        }
+
+        int whole = width / 4;
+        ink += count_gray_bytes((const unsigned char*)line, 4 * whole);
+        for (int x = 4 * whole; x < width; x++) {
+            ink += GET_DATA_BYTE(line, x) < INK_LEVEL;
+        }
+    }
+
+    return (double)ink / ((double)width * height);
+}
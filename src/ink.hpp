@@ -0,0 +1,11 @@
+#ifndef OCR_DEV_INK_HPP
+#define OCR_DEV_INK_HPP
+#include <leptonica/allheaders.h>
+
+// Pixels with a luma below this count as ink.
+const int INK_LEVEL = 128;
+
+// Fraction of ink pixels in an 8 or 32 bpp page image, or -1 for other
+// depths. Uses SSE2 where the compiler targets it.
+double ink_ratio(Pix* image);
+#endif // OCR_DEV_INK_HPP
@@ -0,0 +1,353 @@
+#include "matcher.hpp"
+#include "normalize.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static void cut_pieces(
+    const std::string& keyword, size_t count, std::vector<std::string>& pieces)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t end = keyword.size() * (i + 1) / count;
+        pieces.push_back(keyword.substr(start, end - start));
+        start = end;
+    }
+}
+
+KeywordMatcher::KeywordMatcher(const std::vector<std::string>& keywords,
+    const std::vector<int>& distances, bool normalize)
+    : normalize(normalize)
+{
+    std::vector<std::map<unsigned char, int> > trie(1);
+    std::unordered_map<std::string, int> seen;
+    terminal.push_back(-1);
+
+    for (size_t i = 0; i < keywords.size(); i++) {
+        std::string keyword
+            = normalize ? normalize_keyword(keywords[i]) : keywords[i];
+        if (keyword.empty() || seen.count(keyword)) {
+            continue;
+        }
+        int id = (int)patterns.size();
+        seen[keyword] = id;
+        patterns.push_back(keywords[i]);
+        searched.push_back(keyword);
+
+        int distance = i < distances.size() ? distances[i] : 0;
+        if (keyword.size() > MAX_APPROXIMATE_LENGTH) {
+            distance = 0;
+        }
+        max_distance.push_back(
+            std::max(0, std::min(distance, (int)keyword.size() - 1)));
+
+        int state = 0;
+        for (unsigned char c : keyword) {
+            auto it = trie[state].find(c);
+            if (it == trie[state].end()) {
+                int created = (int)trie.size();
+                trie[state][c] = created;
+                trie.emplace_back();
+                terminal.push_back(-1);
+                state = created;
+            } else {
+                state = it->second;
+            }
+        }
+        terminal[state] = id;
+    }
+
+    size_t num_states = trie.size();
+    edge_begin.assign(num_states + 1, 0);
+    for (size_t s = 0; s < num_states; s++) {
+        edge_begin[s + 1] = edge_begin[s] + (int)trie[s].size();
+        for (const auto& edge : trie[s]) {
+            edge_label.push_back(edge.first);
+            edge_target.push_back(edge.second);
+        }
+    }
+
+    root_next.assign(256, 0);
+    for (const auto& edge : trie[0]) {
+        root_next[edge.first] = edge.second;
+    }
+
+    fail.assign(num_states, 0);
+    output.assign(num_states, -1);
+    std::queue<int> pending;
+    for (const auto& edge : trie[0]) {
+        pending.push(edge.second);
+    }
+
+    while (!pending.empty()) {
+        int state = pending.front();
+        pending.pop();
+        for (const auto& edge : trie[state]) {
+            int child = edge.second;
+            int f = fail[state];
+            while (f != 0 && trie[f].find(edge.first) == trie[f].end()) {
+                f = fail[f];
+            }
+            auto it = trie[f].find(edge.first);
+            fail[child] = (it != trie[f].end()) ? it->second : 0;
+            int link = fail[child];
+            output[child] = terminal[link] != -1 ? link : output[link];
+            pending.push(child);
+        }
+    }
+
+    std::vector<std::string> piece_list;
+    for (size_t id = 0; id < searched.size(); id++) {
+        if (max_distance[id] > 0) {
+            cut_pieces(searched[id], max_distance[id] + 1, piece_list);
+        }
+    }
+    if (piece_list.empty()) {
+        return;
+    }
+
+    pieces.reset(new KeywordMatcher(piece_list));
+    std::unordered_map<std::string, int> piece_ids;
+    for (size_t id = 0; id < pieces->keywords().size(); id++) {
+        piece_ids[pieces->keywords()[id]] = (int)id;
+    }
+    piece_owners.resize(pieces->keywords().size());
+    for (size_t id = 0; id < searched.size(); id++) {
+        if (max_distance[id] == 0) {
+            continue;
+        }
+        std::vector<std::string> cut;
+        cut_pieces(searched[id], max_distance[id] + 1, cut);
+        for (const std::string& piece : cut) {
+            std::vector<int>& owners = piece_owners[piece_ids[piece]];
+            if (owners.empty() || owners.back() != (int)id) {
+                owners.push_back((int)id);
+            }
+        }
+    }
+}
+
+int KeywordMatcher::next_state(int state, unsigned char c) const
+{
+    while (state != 0) {
+        auto first = edge_label.begin() + edge_begin[state];
+        auto last = edge_label.begin() + edge_begin[state + 1];
+        auto it = std::lower_bound(first, last, c);
+        if (it != last && *it == c) {
+            return edge_target[it - edge_label.begin()];
+        }
+        state = fail[state];
+    }
+
+    return root_next[c];
+}
+
+static void restore_offsets(const NormalizedText& normalized, size_t first,
+    std::vector<KeywordMatch>& matches)
+{
+    for (size_t i = first; i < matches.size(); i++) {
+        KeywordMatch& match = matches[i];
+        size_t last = match.end > match.start ? match.end - 1 : match.start;
+        match.start = normalized.starts[match.start];
+        match.end = normalized.ends[last];
+    }
+}
+
+void KeywordMatcher::find_all(
+    const char* text, std::vector<KeywordMatch>& matches) const
+{
+    if (!normalize) {
+        scan(text, matches);
+        return;
+    }
+
+    NormalizedText normalized;
+    normalize_text(text, normalized);
+    size_t first = matches.size();
+    scan(normalized.text.c_str(), matches);
+    restore_offsets(normalized, first, matches);
+}
+
+void KeywordMatcher::scan(
+    const char* text, std::vector<KeywordMatch>& matches) const
+{
+    int state = 0;
+
+    for (size_t i = 0; text[i] != '\0'; i++) {
+        state = next_state(state, (unsigned char)text[i]);
+        int hit = terminal[state] != -1 ? state : output[state];
+        while (hit != -1) {
+            int id = terminal[hit];
+            size_t end = i + 1;
+            matches.push_back({ id, end - searched[id].size(), end });
+            hit = output[hit];
+        }
+    }
+}
+
+// Myers' bit-vector algorithm with a free start in the text. Keeps the
+// first end position with the lowest distance that is within max_distance.
+static bool search_approximate(const std::string& pattern, int max_distance,
+    const char* text, size_t length, KeywordMatch& match)
+{
+    uint64_t peq[256] = {};
+    size_t m = pattern.size();
+    for (size_t i = 0; i < m; i++) {
+        peq[(unsigned char)pattern[i]] |= (uint64_t)1 << i;
+    }
+
+    uint64_t high = (uint64_t)1 << (m - 1);
+    uint64_t pv = ~(uint64_t)0;
+    uint64_t mv = 0;
+    int score = (int)m;
+    int best = max_distance + 1;
+
+    for (size_t j = 0; j < length; j++) {
+        uint64_t eq = peq[(unsigned char)text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & high) {
+            score++;
+        } else if (mh & high) {
+            score--;
+        }
+        ph <<= 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        if (score < best) {
+            best = score;
+            match.end = j + 1;
+            if (best == 0) {
+                break;
+            }
+        }
+    }
+
+    if (best > max_distance) {
+        return false;
+    }
+    match.distance = best;
+
+    // Align the reversed pattern backwards from the end to find the start.
+    size_t window = std::min(match.end, m + (size_t)best);
+    std::vector<int> column(m + 1);
+    for (size_t i = 0; i <= m; i++) {
+        column[i] = (int)i;
+    }
+    size_t start_offset = 0;
+    int start_score = column[m];
+    for (size_t j = 1; j <= window; j++) {
+        unsigned char c = text[match.end - j];
+        int diagonal = column[0];
+        column[0] = (int)j;
+        for (size_t i = 1; i <= m; i++) {
+            int substitute
+                = diagonal + ((unsigned char)pattern[m - i] == c ? 0 : 1);
+            diagonal = column[i];
+            column[i] = std::min(
+                substitute, std::min(column[i] + 1, column[i - 1] + 1));
+        }
+        if (column[m] < start_score
+            || (column[m] == start_score && j <= m)) {
+            start_score = column[m];
+            start_offset = j;
+        }
+    }
+    match.start = match.end - start_offset;
+
+    return true;
+}
+
+void KeywordMatcher::find_approximate(
+    const char* text, std::vector<KeywordMatch>& matches) const
+{
+    if (!pieces) {
+        return;
+    } else if (!normalize) {
+        scan_approximate(text, matches);
+        return;
+    }
+
+    NormalizedText normalized;
+    normalize_text(text, normalized);
+    size_t first = matches.size();
+    scan_approximate(normalized.text.c_str(), matches);
+    restore_offsets(normalized, first, matches);
+}
+
+void KeywordMatcher::scan_approximate(
+    const char* text, std::vector<KeywordMatch>& matches) const
+{
+    std::vector<KeywordMatch> hits;
+    pieces->find_all(text, hits);
+    std::vector<int> candidates;
+    for (const KeywordMatch& hit : hits) {
+        const std::vector<int>& owners = piece_owners[hit.keyword];
+        candidates.insert(candidates.end(), owners.begin(), owners.end());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+        candidates.end());
+
+    size_t length = strlen(text);
+    for (int id : candidates) {
+        KeywordMatch match = { id, 0, 0 };
+        if (search_approximate(
+                searched[id], max_distance[id], text, length, match)) {
+            matches.push_back(match);
+        }
+    }
+}
+
+bool KeywordMatcher::contains_any(const char* text) const
+{
+    NormalizedText normalized;
+    if (normalize) {
+        normalize_text(text, normalized);
+        text = normalized.text.c_str();
+    }
+
+    int state = 0;
+
+    for (size_t i = 0; text[i] != '\0'; i++) {
+        state = next_state(state, (unsigned char)text[i]);
+        if (terminal[state] != -1 || output[state] != -1) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Allows one error per six characters, up to three, so that pieces stay at
+// least three characters long; shorter keywords must appear intact.
+static std::vector<std::string> split_pieces(
+    const std::vector<std::string>& keywords, bool normalize)
+{
+    std::vector<std::string> pieces;
+
+    for (const std::string& original : keywords) {
+        std::string keyword
+            = normalize ? normalize_keyword(original) : original;
+        size_t errors = std::min<size_t>(keyword.size() / 6, 3);
+        cut_pieces(keyword, errors + 1, pieces);
+    }
+
+    return pieces;
+}
+
+CandidateFilter::CandidateFilter(
+    const std::vector<std::string>& keywords, bool normalize)
+    : pieces(split_pieces(keywords, normalize), {}, normalize)
+{
+}
@@ -0,0 +1,70 @@
+#ifndef OCR_DEV_MATCHER_HPP
+#define OCR_DEV_MATCHER_HPP
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct KeywordMatch {
+    int keyword;
+    size_t start;
+    size_t end;
+    int distance = 0;
+};
+
+const size_t MAX_APPROXIMATE_LENGTH = 64;
+
+// Aho-Corasick automaton over the keyword list, so a line is scanned once
+// no matter how many keywords there are.
+//
+// distances gives each keyword's allowed edit distance for
+// find_approximate(). Keywords with a non-zero distance are cut into
+// distance + 1 pieces; at least one piece survives that many edits intact,
+// so only keywords with a piece in the text get a bit-parallel (Myers)
+// scan. Keywords longer than MAX_APPROXIMATE_LENGTH only match exactly.
+//
+// With normalize, keywords are folded once up front and each text once per
+// call (see normalize.hpp); match offsets refer to the original text.
+class KeywordMatcher {
+public:
+    explicit KeywordMatcher(const std::vector<std::string>& keywords,
+        const std::vector<int>& distances = {}, bool normalize = false);
+    const std::vector<std::string>& keywords() const { return patterns; }
+    bool approximate() const { return pieces != nullptr; }
+    void find_all(const char* text, std::vector<KeywordMatch>& matches) const;
+    void find_approximate(
+        const char* text, std::vector<KeywordMatch>& matches) const;
+    bool contains_any(const char* text) const;
+
+private:
+    std::vector<std::string> patterns;
+    std::vector<std::string> searched;
+    bool normalize;
+    std::vector<int> root_next;
+    std::vector<int> edge_begin;
+    std::vector<unsigned char> edge_label;
+    std::vector<int> edge_target;
+    std::vector<int> fail;
+    std::vector<int> output;
+    std::vector<int> terminal;
+    std::vector<int> max_distance;
+    std::unique_ptr<KeywordMatcher> pieces;
+    std::vector<std::vector<int> > piece_owners;
+    int next_state(int state, unsigned char c) const;
+    void scan(const char* text, std::vector<KeywordMatch>& matches) const;
+    void scan_approximate(
+        const char* text, std::vector<KeywordMatch>& matches) const;
+};
+
+// Flags text that may hold a keyword with a few OCR errors. A keyword cut
+// into k + 1 pieces keeps at least one piece intact under k edits, so text
+// containing any piece is a candidate.
+class CandidateFilter {
+public:
+    CandidateFilter(const std::vector<std::string>& keywords, bool normalize);
+    bool matches(const char* text) const { return pieces.contains_any(text); }
+
+private:
+    KeywordMatcher pieces;
+};
+#endif // OCR_DEV_MATCHER_HPP
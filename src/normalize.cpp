@@ -0,0 +1,70 @@
+#include "normalize.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+typedef enum Fold { Keep, Drop, Dash } Fold;
+
+// Classifies the character at text, setting length to its size in bytes.
+static Fold classify(const unsigned char* text, size_t& length)
+{
+    length = 1;
+    unsigned char c = text[0];
+    if (c == ' ' || (c >= '\t' && c <= '\r')) {
+        return Drop;
+    } else if (c == 0xC2 && (text[1] == 0xA0 || text[1] == 0xAD)) {
+        length = 2;
+        return Drop;
+    } else if (c == 0xE2 && text[1] == 0x80 && text[2] != '\0') {
+        length = 3;
+        if (text[2] >= 0x90 && text[2] <= 0x95) {
+            return Dash;
+        } else if (text[2] <= 0x8B || text[2] == 0xAF) {
+            return Drop;
+        }
+    } else if (c == 0xE2 && text[1] == 0x88 && text[2] == 0x92) {
+        length = 3;
+        return Dash;
+    } else if (c == 0xE3 && text[1] == 0x80 && text[2] == 0x80) {
+        length = 3;
+        return Drop;
+    } else if (c == 0xEF && text[1] == 0xBC && text[2] == 0x8D) {
+        length = 3;
+        return Dash;
+    }
+
+    return Keep;
+}
+
+void normalize_text(const char* text, NormalizedText& normalized)
+{
+    const auto* bytes = (const unsigned char*)text;
+    size_t length;
+
+    normalized.text.clear();
+    normalized.starts.clear();
+    normalized.ends.clear();
+    for (size_t i = 0; bytes[i] != '\0'; i += length) {
+        Fold fold = classify(bytes + i, length);
+        if (fold == Drop) {
+            continue;
+        } else if (fold == Dash) {
+            normalized.text.push_back('-');
+            normalized.starts.push_back(i);
+            normalized.ends.push_back(i + length);
+            continue;
+        }
+        for (size_t j = 0; j < length; j++) {
+            normalized.text.push_back(text[i + j]);
+            normalized.starts.push_back(i);
+            normalized.ends.push_back(i + length);
+        }
+    }
+}
+
+std::string normalize_keyword(const std::string& keyword)
+{
+    NormalizedText normalized;
+    normalize_text(keyword.c_str(), normalized);
+    return normalized.text;
+}
@@ -0,0 +1,19 @@
+#ifndef OCR_DEV_NORMALIZE_HPP
+#define OCR_DEV_NORMALIZE_HPP
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Canonical form used by --normalize: whitespace, including the Unicode
+// spaces and soft hyphens OCR tends to produce, is dropped and dash
+// variants become '-'. Byte i of text came from bytes [starts[i], ends[i])
+// of the original.
+typedef struct NormalizedText {
+    std::string text;
+    std::vector<size_t> starts;
+    std::vector<size_t> ends;
+} NormalizedText;
+
+void normalize_text(const char* text, NormalizedText& normalized);
+std::string normalize_keyword(const std::string& keyword);
+#endif // OCR_DEV_NORMALIZE_HPP
@@ -0,0 +1,205 @@
+#include "ocr_cache.hpp"
+#include "text_line.hpp"
+#include "thirdparty/json.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+static const char* CACHE_SUFFIX = ".ocr.json";
+
+static uint64_t fnv1a(const char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string to_hex(uint64_t value)
+{
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)value);
+    return buffer;
+}
+
+static bool is_entry(const fs::directory_entry& entry)
+{
+    const std::string name = entry.path().filename().string();
+    size_t suffix = std::char_traits<char>::length(CACHE_SUFFIX);
+    return entry.is_regular_file() && name.size() > suffix
+        && name.compare(name.size() - suffix, suffix, CACHE_SUFFIX) == 0;
+}
+
+OcrCache::OcrCache(
+    const std::string& dir, uintmax_t max_bytes, const std::string& settings)
+    : dir(dir)
+    , max_bytes(max_bytes)
+    , settings_hash(to_hex(fnv1a(settings.data(), settings.size())))
+    , total_bytes(0)
+{
+    pthread_mutex_init(&lock, nullptr);
+}
+
+OcrCache::~OcrCache() { pthread_mutex_destroy(&lock); }
+
+int OcrCache::open()
+{
+    std::error_code error;
+    fs::create_directories(dir, error);
+    if (error) {
+        std::cerr << "Unable to create cache directory '" << dir.string()
+                  << "': " << error.message() << std::endl;
+        return 0;
+    }
+
+    for (const auto& entry : fs::directory_iterator(dir, error)) {
+        if (is_entry(entry)) {
+            total_bytes += entry.file_size(error);
+        }
+    }
+
+    return 1;
+}
+
+// Hashes the whole file; the size is part of the name as well, so a
+// collision would also need equal lengths.
+std::string OcrCache::fingerprint(const char* data, size_t size)
+{
+    return to_hex(fnv1a(data, size)) + "-" + std::to_string(size);
+}
+
+fs::path OcrCache::entry_path(const std::string& document, int page) const
+{
+    return dir
+        / (document + "-p" + std::to_string(page) + "-" + settings_hash
+            + CACHE_SUFFIX);
+}
+
+int OcrCache::load(
+    const std::string& document, int page, std::vector<TextLine>& lines)
+{
+    fs::path path = entry_path(document, page);
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    json entry = json::parse(file, nullptr, false);
+    if (entry.is_discarded() || !entry.contains("lines")) {
+        return 0;
+    }
+
+    try {
+        for (const json& item : entry["lines"]) {
+            TextLine line;
+            line.text = item["text"].get<std::string>();
+            line.x1 = item["box"][0].get<int>();
+            line.y1 = item["box"][1].get<int>();
+            line.x2 = item["box"][2].get<int>();
+            line.y2 = item["box"][3].get<int>();
+            line.confidence = item["confidence"].get<float>();
+            for (const json& c : item["chars"]) {
+                line.chars.push_back({ c[0].get<size_t>(), c[1].get<size_t>(),
+                    c[2].get<int>(), c[3].get<int>(), c[4].get<int>(),
+                    c[5].get<int>() });
+            }
+            lines.push_back(std::move(line));
+        }
+    } catch (const json::exception&) {
+        lines.clear();
+        return 0;
+    }
+
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    return 1;
+}
+
+void OcrCache::store(const std::string& document, int page,
+    const std::vector<TextLine>& lines)
+{
+    json entry = { { "lines", json::array() } };
+    for (const TextLine& line : lines) {
+        json chars = json::array();
+        for (const CharBox& c : line.chars) {
+            chars.push_back({ c.start, c.end, c.x1, c.y1, c.x2, c.y2 });
+        }
+        entry["lines"].push_back({ { "text", line.text },
+            { "box", { line.x1, line.y1, line.x2, line.y2 } },
+            { "confidence", line.confidence }, { "chars", chars } });
+    }
+
+    // Write under a private name and rename, so concurrent readers, even
+    // from other processes, never see a partial entry.
+    fs::path path = entry_path(document, page);
+    fs::path temporary = path;
+    temporary += "." + std::to_string(getpid()) + "."
+        + std::to_string((uintptr_t)pthread_self()) + ".tmp";
+    std::string data = entry.dump();
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        if (!file.write(data.data(), data.size())) {
+            std::error_code error;
+            fs::remove(temporary, error);
+            return;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(temporary, path, error);
+    if (error) {
+        fs::remove(temporary, error);
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    total_bytes += data.size();
+    if (max_bytes > 0 && total_bytes > max_bytes) {
+        evict();
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+// Removes the oldest entries until the cache is back under 90% of its
+// limit, recounting from disk since other processes may share it.
+void OcrCache::evict()
+{
+    std::vector<std::pair<fs::file_time_type, fs::path> > entries;
+    std::error_code error;
+    total_bytes = 0;
+
+    for (const auto& entry : fs::directory_iterator(dir, error)) {
+        if (!is_entry(entry)) {
+            continue;
+        }
+        uintmax_t size = entry.file_size(error);
+        total_bytes += size;
+        entries.push_back({ entry.last_write_time(error), entry.path() });
+    }
+    std::sort(entries.begin(), entries.end());
+
+    uintmax_t target = max_bytes / 10 * 9;
+    for (const auto& entry : entries) {
+        if (total_bytes <= target) {
+            break;
+        }
+        uintmax_t size = fs::file_size(entry.second, error);
+        if (!error && fs::remove(entry.second, error)) {
+            total_bytes -= std::min(size, total_bytes);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef OCR_DEV_OCR_CACHE_HPP
+#define OCR_DEV_OCR_CACHE_HPP
+#include "text_line.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+// On-disk store of recognized page lines: one JSON file per page, named
+// after the document fingerprint, the page number and a hash of the OCR
+// settings. Reads refresh a file's mtime. Once the directory grows past
+// max_bytes, writes evict the least recently used files.
+class OcrCache {
+public:
+    OcrCache(const std::string& dir, uintmax_t max_bytes,
+        const std::string& settings);
+    OcrCache(const OcrCache&) = delete;
+    OcrCache& operator=(const OcrCache&) = delete;
+    ~OcrCache();
+    int open();
+    static std::string fingerprint(const char* data, size_t size);
+    int load(const std::string& document, int page,
+        std::vector<TextLine>& lines);
+    void store(const std::string& document, int page,
+        const std::vector<TextLine>& lines);
+
+private:
+    std::filesystem::path dir;
+    uintmax_t max_bytes;
+    std::string settings_hash;
+    uintmax_t total_bytes;
+    pthread_mutex_t lock;
+    std::filesystem::path entry_path(
+        const std::string& document, int page) const;
+    void evict();
+};
+#endif // OCR_DEV_OCR_CACHE_HPP
@@ -0,0 +1,234 @@
+#include "options.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+void print_usage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " [options] <path to file> <path to keywords> <page num>"
+                 " [threads]"
+              << std::endl
+              << "       " << program
+              << " --batch [options] <manifest|-> <path to keywords> <page num>"
+                 " [threads]"
+              << std::endl
+              << "       " << program
+              << " --serve=<socket> [options] <path to keywords> [threads]"
+              << std::endl
+              << "Options:" << std::endl
+              << "  --render-to-file   round-trip each page through a JPEG "
+                 "file instead of rendering in memory"
+              << std::endl
+              << "  --text-layer       match against the PDF text layer and "
+                 "only OCR pages with fewer than 20 letters or digits in it"
+              << std::endl
+              << "  --render-threads=N run a render stage with N threads "
+                 "feeding a separate OCR stage"
+              << std::endl
+              << "  --ocr-threads=N    OCR threads in the staged pipeline "
+                 "(default: [threads])"
+              << std::endl
+              << "  --queue-depth=N    rendered pages buffered between stages "
+                 "(default: 2 per OCR thread)"
+              << std::endl
+              << "  --stream[=ordered] print one JSON object per page as it "
+                 "completes, optionally in page order"
+              << std::endl
+              << "  --timings          add per-stage timings (ms) to each page "
+                 "and per-worker totals on stderr"
+              << std::endl
+              << "  --gray             render pages as 8-bit grayscale instead "
+                 "of ARGB32"
+              << std::endl
+              << "  --batch            read PDF paths, one per line, from a "
+                 "manifest file or stdin (-)"
+              << std::endl
+              << "  --serve=PATH       answer JSON scan requests on a Unix "
+                 "socket with warm engines"
+              << std::endl
+              << "  --tessdata=DIR     map DIR/eng.traineddata once and share "
+                 "it (default: $TESSDATA_PREFIX)"
+              << std::endl
+              << "  --first-match      stop each document after the first "
+                 "page with a match"
+              << std::endl
+              << "  --until-all-found  stop each document once every keyword "
+                 "has been found"
+              << std::endl
+              << "  --roi=T[,B]        OCR only the top T and bottom B "
+                 "fractions of a page (B defaults"
+              << std::endl
+              << "                     to T), falling back to the full page "
+                 "when nothing matches"
+              << std::endl
+              << "  --coarse-dpi=N     OCR pages at N dpi and re-render only "
+                 "likely matching lines at"
+              << std::endl
+              << "                     300 dpi to confirm them (replaces "
+                 "--roi)"
+              << std::endl
+              << "  --max-distance=N   also match keywords within N edits; a "
+                 "keyword line may set"
+              << std::endl
+              << "                     its own limit after a TAB"
+              << std::endl
+              << "  --normalize        ignore whitespace and treat dash "
+                 "variants as '-' when matching"
+              << std::endl
+              << "  --cache-dir=DIR    reuse OCR lines of previously "
+                 "recognized pages stored in DIR"
+              << std::endl
+              << "  --cache-size=MB    evict least recently used cache "
+                 "entries above MB (default: 1024)"
+              << std::endl
+              << "  --split-page=N     cut a page into up to N overlapping "
+                 "strips for engines that"
+              << std::endl
+              << "                     have run out of pages"
+              << std::endl
+              << "  --blank-threshold=F skip OCR of pages with less than F of "
+                 "their pixels inked"
+              << std::endl
+              << "[threads] is a worker count or auto (the default), which "
+                 "fits workers and"
+              << std::endl
+              << "OMP_THREAD_LIMIT to the CPU quota, affinity mask and page "
+                 "count."
+              << std::endl;
+}
+
+static int parse_count(
+    const std::string& name, const std::string& value, long& count)
+{
+    char* end = nullptr;
+    count = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || count <= 0) {
+        std::cerr << "Invalid value '" << value << "' for --" << name << "."
+                  << std::endl;
+        return 0;
+    }
+
+    return 1;
+}
+
+static int parse_fraction(const std::string& name, const std::string& value,
+    double& fraction)
+{
+    char* end = nullptr;
+    fraction = strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || fraction < 0 || fraction >= 1) {
+        std::cerr << "Invalid value '" << value << "' for --" << name << "."
+                  << std::endl;
+        return 0;
+    }
+
+    return 1;
+}
+
+static int parse_roi(
+    const std::string& name, const std::string& value, SearchOptions& options)
+{
+    size_t comma = value.find(',');
+    if (comma == std::string::npos) {
+        if (!parse_fraction(name, value, options.roi_top)) {
+            return 0;
+        }
+        options.roi_bottom = options.roi_top;
+    } else if (!parse_fraction(name, value.substr(0, comma), options.roi_top)
+        || !parse_fraction(
+            name, value.substr(comma + 1), options.roi_bottom)) {
+        return 0;
+    }
+
+    if (options.roi_top + options.roi_bottom == 0) {
+        std::cerr << "--" << name << " needs at least one non-empty band."
+                  << std::endl;
+        return 0;
+    }
+
+    return 1;
+}
+
+static int parse_flag(const std::string& name, const std::string& value,
+    bool has_value, SearchOptions& options)
+{
+    if (name == "render-to-file" && !has_value) {
+        options.render_to_file = true;
+    } else if (name == "text-layer" && !has_value) {
+        options.text_layer = true;
+    } else if (name == "render-threads" && has_value) {
+        return parse_count(name, value, options.render_threads);
+    } else if (name == "ocr-threads" && has_value) {
+        return parse_count(name, value, options.ocr_threads);
+    } else if (name == "queue-depth" && has_value) {
+        return parse_count(name, value, options.queue_depth);
+    } else if (name == "stream" && !has_value) {
+        options.stream = Streamed;
+    } else if (name == "stream" && value == "ordered") {
+        options.stream = StreamedInOrder;
+    } else if (name == "timings" && !has_value) {
+        options.timings = true;
+    } else if (name == "gray" && !has_value) {
+        options.gray = true;
+    } else if (name == "batch" && !has_value) {
+        options.batch = true;
+    } else if (name == "serve" && !value.empty()) {
+        options.serve = value;
+    } else if (name == "tessdata" && !value.empty()) {
+        options.tessdata = value;
+    } else if (name == "first-match" && !has_value) {
+        options.exit_mode = FirstMatch;
+    } else if (name == "until-all-found" && !has_value) {
+        options.exit_mode = AllFound;
+    } else if (name == "roi" && has_value) {
+        return parse_roi(name, value, options);
+    } else if (name == "coarse-dpi" && has_value) {
+        return parse_count(name, value, options.coarse_dpi);
+    } else if (name == "max-distance" && has_value) {
+        return parse_count(name, value, options.max_distance);
+    } else if (name == "normalize" && !has_value) {
+        options.normalize = true;
+    } else if (name == "cache-dir" && !value.empty()) {
+        options.cache_dir = value;
+    } else if (name == "cache-size" && has_value) {
+        return parse_count(name, value, options.cache_size_mb);
+    } else if (name == "split-page" && has_value) {
+        return parse_count(name, value, options.split_page);
+    } else if (name == "blank-threshold" && has_value) {
+        return parse_fraction(name, value, options.blank_threshold);
+    } else {
+        std::cerr << "Unknown option '--" << name;
+        if (has_value) {
+            std::cerr << "=" << value;
+        }
+        std::cerr << "'." << std::endl;
+        return 0;
+    }
+
+    return 1;
+}
+
+int parse_options(int argc, char** argv, SearchOptions& options,
+    std::vector<char*>& positional)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            positional.push_back(argv[i]);
+            continue;
+        }
+
+        std::string arg(argv[i] + 2);
+        auto pos = arg.find('=');
+        bool has_value = pos != std::string::npos;
+        std::string name = has_value ? arg.substr(0, pos) : arg;
+        std::string value = has_value ? arg.substr(pos + 1) : std::string();
+        if (!parse_flag(name, value, has_value, options)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
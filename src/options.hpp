@@ -0,0 +1,36 @@
+#ifndef OCR_DEV_OPTIONS_HPP
+#define OCR_DEV_OPTIONS_HPP
+#include <string>
+#include <vector>
+
+typedef enum StreamMode { Buffered, Streamed, StreamedInOrder } StreamMode;
+typedef enum ExitMode { ScanAll, FirstMatch, AllFound } ExitMode;
+
+struct SearchOptions {
+    bool render_to_file = false;
+    bool text_layer = false;
+    long render_threads = 0;
+    long ocr_threads = 0;
+    long queue_depth = 0;
+    StreamMode stream = Buffered;
+    bool timings = false;
+    bool gray = false;
+    bool batch = false;
+    std::string serve;
+    std::string tessdata;
+    ExitMode exit_mode = ScanAll;
+    double roi_top = 0;
+    double roi_bottom = 0;
+    long coarse_dpi = 0;
+    long max_distance = 0;
+    bool normalize = false;
+    std::string cache_dir;
+    long cache_size_mb = 1024;
+    long split_page = 0;
+    double blank_threshold = 0;
+};
+
+void print_usage(const char* program);
+int parse_options(int argc, char** argv, SearchOptions& options,
+    std::vector<char*>& positional);
+#endif // OCR_DEV_OPTIONS_HPP
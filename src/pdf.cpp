@@ -1,3 +1,8 @@
+#include "pdf.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <poppler-document.h>
@@ -5,10 +10,13 @@
 #include <poppler-page-renderer.h>
 #include <poppler-page.h>
 #include <string>
+#include <vector>
 
-int convert_pdf_page(std::unique_ptr<poppler::document>& doc, int page_number,
-    std::string& outfile)
+static int render_page_image(std::unique_ptr<poppler::document>& doc,
+    int page_number, const RenderSettings& settings, poppler::image& image,
+    StageTimings* timings)
 {
+    ScopedStage stage(timings, "render");
     int numPages = doc->pages();
 
     if (page_number < 1 || page_number > numPages) {
@@ -20,18 +28,248 @@ int convert_pdf_page(std::unique_ptr<poppler::document>& doc, int page_number,
     poppler::page_renderer renderer;
     renderer.set_render_hint(poppler::page_renderer::antialiasing, true);
     renderer.set_render_hint(poppler::page_renderer::text_antialiasing, true);
+    if (settings.gray) {
+        renderer.set_image_format(poppler::image::format_gray8);
+    }
 
     // Poppler pages start at index 0
     std::unique_ptr<poppler::page> page(doc->create_page(page_number - 1));
-    poppler::image image
-        = renderer.render_page(page.get(), 300, 300); // 300 DPI
+    image = renderer.render_page(page.get(), settings.dpi, settings.dpi,
+        settings.x, settings.y, settings.width, settings.height);
 
-    if (image.is_valid()) {
-        image.save(outfile, "jpeg");
-    } else {
+    if (!image.is_valid()) {
         std::cerr << "Failed to render page " << page_number << std::endl;
         return 0;
     }
 
     return 1;
-}
\ No newline at end of file
+}
+
+int convert_pdf_page(std::unique_ptr<poppler::document>& doc, int page_number,
+    std::string& outfile, const RenderSettings& settings,
+    StageTimings* timings)
+{
+    poppler::image image;
+
+    if (!render_page_image(doc, page_number, settings, image, timings)) {
+        return 0;
+    }
+
+    ScopedStage stage(timings, "jpegSave");
+    return image.save(outfile, "jpeg") ? 1 : 0;
+}
+
+Pix* render_pdf_page(std::unique_ptr<poppler::document>& doc, int page_number,
+    const RenderSettings& settings, StageTimings* timings)
+{
+    poppler::image image;
+
+    if (!render_page_image(doc, page_number, settings, image, timings)) {
+        return nullptr;
+    }
+
+    ScopedStage stage(timings, "pixConvert");
+    Pix* pix = image_to_pix(image, settings.dpi, settings.gray);
+    if (pix == nullptr) {
+        std::cerr << "Failed to convert page " << page_number << std::endl;
+    }
+
+    return pix;
+}
+
+static inline l_uint32 argb_to_luma(const unsigned char* pixel)
+{
+    uint32_t argb;
+    memcpy(&argb, pixel, sizeof(argb));
+    l_uint32 r = (argb >> 16) & 0xff;
+    l_uint32 g = (argb >> 8) & 0xff;
+    l_uint32 b = argb & 0xff;
+    return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+// Leptonica keeps 8 bpp pixels MSB-first inside native 32-bit words, so
+// whole words are assembled here rather than stored byte by byte.
+static void argb_row_to_gray(
+    const unsigned char* row, l_uint32* line, int width)
+{
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const unsigned char* p = row + 4 * x;
+        line[x / 4] = (argb_to_luma(p) << 24) | (argb_to_luma(p + 4) << 16)
+            | (argb_to_luma(p + 8) << 8) | argb_to_luma(p + 12);
+    }
+    for (; x < width; x++) {
+        SET_DATA_BYTE(line, x, argb_to_luma(row + 4 * x));
+    }
+}
+
+static void gray_row_to_gray(
+    const unsigned char* row, l_uint32* line, int width)
+{
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const unsigned char* p = row + x;
+        line[x / 4] = ((l_uint32)p[0] << 24) | ((l_uint32)p[1] << 16)
+            | ((l_uint32)p[2] << 8) | p[3];
+    }
+    for (; x < width; x++) {
+        SET_DATA_BYTE(line, x, row[x]);
+    }
+}
+
+Pix* image_to_pix(const poppler::image& image, int dpi, bool gray)
+{
+    int width = image.width();
+    int height = image.height();
+    poppler::image::format_enum format = image.format();
+    int depth;
+
+    switch (format) {
+    case poppler::image::format_argb32:
+        depth = gray ? 8 : 32;
+        break;
+    case poppler::image::format_rgb24:
+    case poppler::image::format_bgr24:
+        depth = 32;
+        break;
+    case poppler::image::format_gray8:
+        depth = 8;
+        break;
+    default:
+        return nullptr;
+    }
+
+    Pix* pix = pixCreateNoInit(width, height, depth);
+    if (pix == nullptr) {
+        return nullptr;
+    }
+    pixSetResolution(pix, dpi, dpi);
+
+    const char* src = image.const_data();
+    int src_stride = image.bytes_per_row();
+    l_uint32* dst = pixGetData(pix);
+    int wpl = pixGetWpl(pix);
+
+    for (int y = 0; y < height; y++) {
+        const auto* row = (const unsigned char*)(src + (size_t)y * src_stride);
+        l_uint32* line = dst + (size_t)y * wpl;
+
+        if (format == poppler::image::format_argb32 && depth == 8) {
+            argb_row_to_gray(row, line, width);
+        } else if (format == poppler::image::format_argb32) {
+            // Native-endian 0xAARRGGBB becomes Leptonica's 0xRRGGBBAA.
+            for (int x = 0; x < width; x++) {
+                uint32_t argb;
+                memcpy(&argb, row + 4 * x, sizeof(argb));
+                line[x] = argb << 8;
+            }
+        } else if (format == poppler::image::format_rgb24) {
+            for (int x = 0; x < width; x++) {
+                const unsigned char* p = row + 3 * x;
+                line[x] = ((l_uint32)p[0] << 24) | ((l_uint32)p[1] << 16)
+                    | ((l_uint32)p[2] << 8);
+            }
+        } else if (format == poppler::image::format_bgr24) {
+            for (int x = 0; x < width; x++) {
+                const unsigned char* p = row + 3 * x;
+                line[x] = ((l_uint32)p[2] << 24) | ((l_uint32)p[1] << 16)
+                    | ((l_uint32)p[0] << 8);
+            }
+        } else {
+            gray_row_to_gray(row, line, width);
+        }
+    }
+
+    return pix;
+}
+
+static std::string box_text(const poppler::text_box& box)
+{
+    poppler::byte_array utf8 = box.text().to_utf8();
+    return std::string(utf8.begin(), utf8.end());
+}
+
+static int to_pixels(double points)
+{
+    return (int)(points * RENDER_DPI / 72.0 + 0.5);
+}
+
+// Adds a box per character of box, whose UTF-8 text starts at offset in
+// the line.
+static void add_char_boxes(
+    const poppler::text_box& box, size_t offset, TextLine& line)
+{
+    poppler::ustring text = box.text();
+
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned int unit = text[i];
+        size_t length = unit < 0x80 ? 1 : unit < 0x800 ? 2 : 3;
+        poppler::rectf rect = box.char_bbox(i);
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 1 < text.size()) {
+            length = 4;
+            i++;
+        }
+        line.chars.push_back({ offset, offset + length,
+            to_pixels(rect.left()), to_pixels(rect.top()),
+            to_pixels(rect.right()), to_pixels(rect.bottom()) });
+        offset += length;
+    }
+}
+
+int extract_text_lines(std::unique_ptr<poppler::document>& doc,
+    int page_number, std::vector<TextLine>& lines)
+{
+    std::unique_ptr<poppler::page> page(doc->create_page(page_number - 1));
+    if (!page) {
+        return 0;
+    }
+
+    std::vector<poppler::text_box> boxes = page->text_list();
+    size_t alnum_chars = 0;
+    bool space_after = false;
+    double line_top = 0, line_bottom = 0, last_right = 0;
+
+    for (const poppler::text_box& box : boxes) {
+        std::string text = box_text(box);
+        poppler::rectf rect = box.bbox();
+        double center = rect.y() + rect.height() / 2;
+        bool same_line = !lines.empty() && center >= line_top
+            && center <= line_bottom && rect.x() >= last_right - 1;
+
+        if (!same_line) {
+            lines.emplace_back();
+            TextLine& line = lines.back();
+            line.x1 = to_pixels(rect.left());
+            line.y1 = to_pixels(rect.top());
+            line.x2 = to_pixels(rect.right());
+            line.y2 = to_pixels(rect.bottom());
+            line.confidence = 100;
+            line_top = rect.top();
+            line_bottom = rect.bottom();
+        } else {
+            TextLine& line = lines.back();
+            if (space_after) {
+                line.text += " ";
+            }
+            line.x1 = std::min(line.x1, to_pixels(rect.left()));
+            line.y1 = std::min(line.y1, to_pixels(rect.top()));
+            line.x2 = std::max(line.x2, to_pixels(rect.right()));
+            line.y2 = std::max(line.y2, to_pixels(rect.bottom()));
+        }
+
+        add_char_boxes(box, lines.back().text.size(), lines.back());
+        lines.back().text += text;
+        last_right = rect.right();
+        space_after = box.has_space_after();
+        // Counts ASCII letters and digits and each non-ASCII character once,
+        // by its UTF-8 lead byte.
+        alnum_chars += std::count_if(text.begin(), text.end(),
+            [](unsigned char c) { return c >= 0xC0 || std::isalnum(c); });
+    }
+
+    for (TextLine& line : lines) {
+        line.text += "\n";
+    }
+
+    return alnum_chars >= MIN_TEXT_LAYER_CHARS ? 1 : 0;
+}
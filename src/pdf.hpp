@@ -1,9 +1,35 @@
 #ifndef OCR_DEV_PDF_HPP
 #define OCR_DEV_PDF_HPP
+#include "text_line.hpp"
+#include "timings.hpp"
+#include <leptonica/allheaders.h>
 #include <memory>
 #include <poppler-document.h>
+#include <poppler-image.h>
 #include <string>
+#include <vector>
+
+const int RENDER_DPI = 300;
+// Letters or digits a text layer needs before it replaces OCR of the page.
+const int MIN_TEXT_LAYER_CHARS = 20;
+
+// x, y, width and height select a region in pixels at dpi; -1 renders the
+// whole page.
+typedef struct RenderSettings {
+    int dpi = RENDER_DPI;
+    bool gray = false;
+    int x = -1;
+    int y = -1;
+    int width = -1;
+    int height = -1;
+} RenderSettings;
 
 int convert_pdf_page(std::unique_ptr<poppler::document>& doc, int page_number,
-    std::string& outfile);
+    std::string& outfile, const RenderSettings& settings,
+    StageTimings* timings);
+Pix* render_pdf_page(std::unique_ptr<poppler::document>& doc, int page_number,
+    const RenderSettings& settings, StageTimings* timings);
+Pix* image_to_pix(const poppler::image& image, int dpi, bool gray);
+int extract_text_lines(std::unique_ptr<poppler::document>& doc,
+    int page_number, std::vector<TextLine>& lines);
 #endif // OCR_DEV_PDF_HPP
@@ -0,0 +1,115 @@
+#include "result_sink.hpp"
+#include "thirdparty/json.hpp"
+#include <map>
+#include <ostream>
+#include <pthread.h>
+#include <utility>
+
+using json = nlohmann::json;
+
+ResultSink::ResultSink(std::ostream& out, StreamMode mode, bool group_by_file,
+    const EarlyExit* early_exit)
+    : out(out)
+    , mode(mode)
+    , group_by_file(group_by_file)
+    , early_exit(early_exit)
+    , next_sequence(0)
+{
+    pthread_mutex_init(&lock, nullptr);
+}
+
+ResultSink::~ResultSink() { pthread_mutex_destroy(&lock); }
+
+bool ResultSink::cancelled(long sequence, const PendingPage& page) const
+{
+    return page.result.is_null()
+        || (early_exit != nullptr
+            && early_exit->cancelled(page.document, sequence));
+}
+
+void ResultSink::add(int document, long sequence, json result)
+{
+    pthread_mutex_lock(&lock);
+
+    if (mode == Streamed) {
+        write(result);
+    } else {
+        pending[sequence] = { document, std::move(result) };
+    }
+
+    if (mode == StreamedInOrder) {
+        flush_in_order();
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+void ResultSink::skip(long sequence)
+{
+    if (mode != StreamedInOrder) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    pending[sequence] = { -1, nullptr };
+    flush_in_order();
+    pthread_mutex_unlock(&lock);
+}
+
+void ResultSink::finish()
+{
+    pthread_mutex_lock(&lock);
+
+    if (mode == Buffered && group_by_file) {
+        json all_files_result = json::object();
+        for (auto& page : pending) {
+            if (cancelled(page.first, page.second)) {
+                continue;
+            }
+            json& result = page.second.result;
+            std::string file = result["file"].get<std::string>();
+            json& file_pages = all_files_result[file];
+            if (file_pages.is_null()) {
+                file_pages = json::array();
+            }
+            file_pages.push_back(std::move(result));
+        }
+        out << all_files_result;
+    } else if (mode == Buffered) {
+        json all_pages_result = json::array();
+        for (auto& page : pending) {
+            if (!cancelled(page.first, page.second)) {
+                all_pages_result.push_back(std::move(page.second.result));
+            }
+        }
+        out << all_pages_result;
+    } else {
+        for (const auto& page : pending) {
+            if (!cancelled(page.first, page.second)) {
+                write(page.second.result);
+            }
+        }
+    }
+    pending.clear();
+    out.flush();
+
+    pthread_mutex_unlock(&lock);
+}
+
+void ResultSink::flush_in_order()
+{
+    auto it = pending.begin();
+    while (it != pending.end() && it->first == next_sequence) {
+        if (!cancelled(it->first, it->second)) {
+            write(it->second.result);
+        }
+        it = pending.erase(it);
+        next_sequence++;
+    }
+}
+
+void ResultSink::write(const json& result)
+{
+    out << result.dump() << '\n';
+    out.flush();
+}
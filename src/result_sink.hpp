@@ -0,0 +1,49 @@
+#ifndef OCR_DEV_RESULT_SINK_HPP
+#define OCR_DEV_RESULT_SINK_HPP
+#include "early_exit.hpp"
+#include "options.hpp"
+#include "thirdparty/json.hpp"
+#include <map>
+#include <ostream>
+#include <pthread.h>
+
+// Collects per-page results from all workers, keyed by the page's position
+// in the job. Buffered keeps everything until finish() and prints one array
+// (or, when grouping by file, one object of arrays keyed by "file"); the
+// streamed modes print one JSON object per line as pages complete,
+// StreamedInOrder holding early pages back until the pages before them
+// have been written. Skipped pages print nothing but still let the pages
+// after them through.
+//
+// With an early_exit, pages it has cancelled are left out when a buffered
+// result is printed or an in-order page is written; by then every earlier
+// page has been recorded, so the output does not depend on timing.
+// Streamed writes pages as they arrive and cannot filter them this way.
+class ResultSink {
+public:
+    ResultSink(std::ostream& out, StreamMode mode, bool group_by_file,
+        const EarlyExit* early_exit = nullptr);
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+    ~ResultSink();
+    void add(int document, long sequence, nlohmann::json result);
+    void skip(long sequence);
+    void finish();
+
+private:
+    std::ostream& out;
+    StreamMode mode;
+    bool group_by_file;
+    const EarlyExit* early_exit;
+    long next_sequence;
+    typedef struct PendingPage {
+        int document;
+        nlohmann::json result;
+    } PendingPage;
+    std::map<long, PendingPage> pending;
+    pthread_mutex_t lock;
+    bool cancelled(long sequence, const PendingPage& page) const;
+    void flush_in_order();
+    void write(const nlohmann::json& result);
+};
+#endif // OCR_DEV_RESULT_SINK_HPP
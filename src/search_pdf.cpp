@@ -1,300 +1,2003 @@
+#include "bounded_queue.hpp"
+#include "cpu_budget.hpp"
+#include "early_exit.hpp"
+#include "ink.hpp"
+#include "matcher.hpp"
+#include "ocr_cache.hpp"
+#include "options.hpp"
 #include "pdf.hpp"
+#include "result_sink.hpp"
+#include "server.hpp"
+#include "text_line.hpp"
+#include "timings.hpp"
 #include "thirdparty/json.hpp"
 #include "util.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <leptonica/allheaders.h>
+#include <limits>
 #include <poppler-document.h>
 #include <pthread.h>
+#include <sstream>
 #include <string>
+#include <sys/resource.h>
 #include <tesseract/baseapi.h>
+#include <tesseract/ocrclass.h>
+#include <utility>
 #include <vector>
 
 using json = nlohmann::json;
 
 const char* DOCUMENT_OPEN_FAIL = "Failed to open the document.";
+const char* ENGINE_LANGUAGE = "eng";
 const char* KEYWORDS_OPEN_FAIL = "Unable to open keywords file for reading.";
+const char* ENGINE_INIT_FAIL = "Failed to initialize the OCR engine.";
+const char* PAGE_PROCESS_FAIL = "Failed to process the page.";
+
+const char* SOURCE_OCR = "ocr";
+const char* SOURCE_TEXT_LAYER = "text";
 
 void panic()
 {
-    std::cerr << "Memory error\n";
-    exit(1);
+    std::cerr << "Memory error\n";
+    exit(1);
+}
+
+typedef enum WorkerStatus { Running, Success, Fail } WorkerStatus;
+
+typedef struct Document {
+    std::string path;
+    MappedFile file;
+    std::vector<char> bytes;
+    std::string fingerprint;
+    int first_page = 1;
+    int last_page = 0;
+    const char* data() const
+    {
+        return bytes.empty() ? file.data() : bytes.data();
+    }
+    size_t size() const { return bytes.empty() ? file.size() : bytes.size(); }
+} Document;
+
+typedef std::vector<std::unique_ptr<Document> > DocumentList;
+
+typedef struct PageJob {
+    long sequence;
+    int document;
+    int page_number;
+} PageJob;
+
+class PageQueue {
+public:
+    explicit PageQueue(const DocumentList& documents)
+        : next_job(0)
+        , total_jobs(0)
+    {
+        for (const auto& document : documents) {
+            offsets.push_back(total_jobs);
+            first_pages.push_back(document->first_page);
+            total_jobs += document->last_page - document->first_page + 1;
+        }
+    }
+    long size() const { return total_jobs; }
+    bool pop(PageJob& job)
+    {
+        long sequence = next_job.fetch_add(1);
+        if (sequence >= total_jobs) {
+            return false;
+        }
+        auto it = std::upper_bound(offsets.begin(), offsets.end(), sequence);
+        int document = (int)(it - offsets.begin()) - 1;
+        job.sequence = sequence;
+        job.document = document;
+        job.page_number
+            = first_pages[document] + (int)(sequence - offsets[document]);
+        return true;
+    }
+
+private:
+    std::atomic<long> next_job;
+    long total_jobs;
+    std::vector<long> offsets;
+    std::vector<int> first_pages;
+};
+
+typedef struct WorkerStats {
+    const char* role = "page";
+    int pages = 0;
+    int blank_pages = 0;
+    double busy_ms = 0;
+    StageTimings timings;
+} WorkerStats;
+
+typedef struct RenderedPage {
+    PageJob job;
+    Pix* image;
+    StageTimings timings;
+} RenderedPage;
+
+class Pipeline {
+public:
+    Pipeline(size_t depth, int renderers, int recognizers)
+        : rendered(depth)
+        , renderers(renderers)
+        , recognizers(recognizers)
+    {
+    }
+    BoundedQueue<RenderedPage> rendered;
+    void renderer_done()
+    {
+        if (renderers.fetch_sub(1) == 1) {
+            rendered.close();
+        }
+    }
+    void recognizer_done()
+    {
+        if (recognizers.fetch_sub(1) == 1) {
+            rendered.close();
+            RenderedPage page;
+            while (rendered.pop(page)) {
+                pixDestroy(&page.image);
+            }
+        }
+    }
+
+private:
+    std::atomic<int> renderers;
+    std::atomic<int> recognizers;
+};
+
+// Counts down the strips of one page as they are recognized.
+class StripGroup {
+public:
+    explicit StripGroup(int strips)
+        : remaining(strips)
+        , failed(false)
+    {
+        pthread_mutex_init(&lock, nullptr);
+        pthread_cond_init(&changed, nullptr);
+    }
+    StripGroup(const StripGroup&) = delete;
+    StripGroup& operator=(const StripGroup&) = delete;
+    ~StripGroup()
+    {
+        pthread_cond_destroy(&changed);
+        pthread_mutex_destroy(&lock);
+    }
+    void done(int recognized)
+    {
+        pthread_mutex_lock(&lock);
+        remaining--;
+        failed = failed || !recognized;
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&lock);
+    }
+    bool finished()
+    {
+        pthread_mutex_lock(&lock);
+        bool finished = remaining == 0;
+        pthread_mutex_unlock(&lock);
+        return finished;
+    }
+    // Returns 0 if any strip failed to be recognized.
+    int wait()
+    {
+        pthread_mutex_lock(&lock);
+        while (remaining > 0) {
+            pthread_cond_wait(&changed, &lock);
+        }
+        int recognized = !failed;
+        pthread_mutex_unlock(&lock);
+        return recognized;
+    }
+
+private:
+    int remaining;
+    bool failed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+typedef struct StripJob {
+    Pix* image;
+    int y;
+    tesseract::ETEXT_DESC* monitor;
+    std::vector<TextLine>* lines;
+    StripGroup* group;
+} StripJob;
+
+// Lends the engines of workers that have run out of pages to pages still
+// being recognized. While helpers are idle, a page is cut into up to
+// max_strips overlapping horizontal strips and the helpers recognize the
+// strips its worker queues. The queue closes once every worker is done
+// with its own pages.
+class PageStrips {
+public:
+    PageStrips(long max_strips, int workers)
+        : jobs((size_t)(max_strips * workers))
+        , max_strips(max_strips)
+        , active(workers)
+        , helpers(0)
+    {
+    }
+    BoundedQueue<StripJob> jobs;
+    long strip_count() const
+    {
+        return std::min(max_strips, (long)helpers + 1);
+    }
+    void worker_done()
+    {
+        helpers++;
+        if (active.fetch_sub(1) == 1) {
+            jobs.close();
+        }
+    }
+
+private:
+    long max_strips;
+    std::atomic<int> active;
+    std::atomic<int> helpers;
+};
+
+class WorkerArgs {
+public:
+    int worker_index;
+    PageQueue& pages;
+    ResultSink& results;
+    const KeywordMatcher& matcher;
+    const CandidateFilter* candidates;
+    const DocumentList& documents;
+    EarlyExit& early_exit;
+    const SearchOptions& options;
+    Pipeline* pipeline;
+    WorkerStatus* status;
+    WorkerStats* stats;
+    const MappedFile* model;
+    OcrCache* cache;
+    PageStrips* strips;
+    WorkerArgs(int workerIndex, PageQueue& pages, ResultSink& results,
+        const KeywordMatcher& matcher, const CandidateFilter* candidates,
+        const DocumentList& documents, EarlyExit& early_exit,
+        const SearchOptions& options, Pipeline* pipeline,
+        WorkerStatus* status, WorkerStats* stats, const MappedFile* model,
+        OcrCache* cache, PageStrips* strips)
+        : worker_index(workerIndex)
+        , pages(pages)
+        , results(results)
+        , matcher(matcher)
+        , candidates(candidates)
+        , documents(documents)
+        , early_exit(early_exit)
+        , options(options)
+        , pipeline(pipeline)
+        , status(status)
+        , stats(stats)
+        , model(model)
+        , cache(cache)
+        , strips(strips)
+    {
+    }
+};
+
+// Union of the character boxes overlapping [start, end), or the whole line
+// when it has no character boxes there.
+void span_box(const TextLine& line, size_t start, size_t end, json& bbox)
+{
+    int x1 = line.x2, y1 = line.y2, x2 = line.x1, y2 = line.y1;
+    bool covered = false;
+
+    for (const CharBox& box : line.chars) {
+        if (box.end <= start || box.start >= end) {
+            continue;
+        }
+        x1 = std::min(x1, box.x1);
+        y1 = std::min(y1, box.y1);
+        x2 = std::max(x2, box.x2);
+        y2 = std::max(y2, box.y2);
+        covered = true;
+    }
+
+    bbox["xStart"] = covered ? x1 : line.x1;
+    bbox["xEnd"] = covered ? x2 : line.x2;
+    bbox["yStart"] = covered ? y1 : line.y1;
+    bbox["yEnd"] = covered ? y2 : line.y2;
+}
+
+// Reports every exact occurrence. Approximate hits only come in for
+// keywords without an exact one on the line, at most one per keyword.
+void process_line(const TextLine& line, const char* source,
+    const KeywordMatcher& matcher, json& found_keywords)
+{
+    std::vector<KeywordMatch> matches;
+    matcher.find_all(line.text.c_str(), matches);
+    size_t exact = matches.size();
+    matcher.find_approximate(line.text.c_str(), matches);
+
+    for (size_t i = 0; i < matches.size(); i++) {
+        const KeywordMatch& match = matches[i];
+        if (i >= exact
+            && std::any_of(matches.begin(), matches.begin() + exact,
+                [&](const KeywordMatch& other) {
+                    return other.keyword == match.keyword;
+                })) {
+            continue;
+        }
+
+        const std::string& keyword = matcher.keywords()[match.keyword];
+        json bbox = json::object();
+        if (!found_keywords.contains(keyword)) {
+            found_keywords[keyword] = json::array();
+        }
+        bbox["startPos"] = match.start;
+        bbox["endPos"] = match.end;
+        bbox["confidence"] = line.confidence;
+        span_box(line, match.start, match.end, bbox);
+        bbox["lineBox"] = { { "xStart", line.x1 }, { "xEnd", line.x2 },
+            { "yStart", line.y1 }, { "yEnd", line.y2 } };
+        bbox["text"] = line.text;
+        bbox["source"] = source;
+        if (matcher.approximate()) {
+            bbox["distance"] = match.distance;
+        }
+        found_keywords[keyword].push_back(bbox);
+    }
+}
+
+void search_lines(const std::vector<TextLine>& lines, const char* source,
+    const KeywordMatcher& matcher, json& result)
+{
+    json found_keywords = json::object();
+
+    for (const TextLine& line : lines) {
+        process_line(line, source, matcher, found_keywords);
+    }
+
+    if (!found_keywords.empty()) {
+        result["found"] = found_keywords;
+    }
+}
+
+// Lets Tesseract abandon a page mid-recognition once an early exit has made
+// it unnecessary.
+class JobMonitor {
+public:
+    JobMonitor(const EarlyExit& early_exit, const PageJob& job)
+        : early_exit(early_exit)
+        , job(job)
+    {
+        monitor.cancel = cancel;
+        monitor.cancel_this = this;
+    }
+    tesseract::ETEXT_DESC* get() { return &monitor; }
+
+private:
+    const EarlyExit& early_exit;
+    PageJob job;
+    tesseract::ETEXT_DESC monitor;
+    static bool cancel(void* _self, int /*words*/)
+    {
+        auto* self = (JobMonitor*)_self;
+        const PageJob& job = self->job;
+        return self->early_exit.cancelled(job.document, job.sequence);
+    }
+};
+
+bool recognition_cancelled(tesseract::ETEXT_DESC* monitor)
+{
+    return monitor != nullptr && monitor->cancel != nullptr
+        && monitor->cancel(monitor->cancel_this, 0);
+}
+
+// Returns 0 when Recognize fails or is cancelled; lines then hold at most
+// part of the image. A cancel seen only after Recognize returns counts
+// too, since Tesseract may stop early without reporting it.
+int read_lines(tesseract::TessBaseAPI* api, tesseract::ETEXT_DESC* monitor,
+    std::vector<TextLine>& lines)
+{
+    if (api->Recognize(monitor) != 0 || recognition_cancelled(monitor)) {
+        return 0;
+    }
+    tesseract::ResultIterator* ri = api->GetIterator();
+    tesseract::PageIteratorLevel level = tesseract::RIL_TEXTLINE;
+    tesseract::PageIteratorLevel symbol = tesseract::RIL_SYMBOL;
+    bool more = ri != nullptr;
+    while (more) {
+        char* scanned_line = ri->GetUTF8Text(level);
+        if (scanned_line == nullptr) {
+            more = ri->Next(level);
+            continue;
+        }
+        TextLine line;
+        line.text = scanned_line;
+        delete[] scanned_line;
+        ri->BoundingBox(level, &line.x1, &line.y1, &line.x2, &line.y2);
+        line.confidence = ri->Confidence(level);
+
+        // Walk the line's symbols, locating each in the line text.
+        size_t offset = 0;
+        do {
+            char* scanned_symbol = ri->GetUTF8Text(symbol);
+            if (scanned_symbol == nullptr) {
+                continue;
+            }
+            size_t start = line.text.find(scanned_symbol, offset);
+            if (start != std::string::npos) {
+                CharBox box;
+                box.start = start;
+                box.end = start + strlen(scanned_symbol);
+                ri->BoundingBox(symbol, &box.x1, &box.y1, &box.x2, &box.y2);
+                line.chars.push_back(box);
+                offset = box.end;
+            }
+            delete[] scanned_symbol;
+        } while ((more = ri->Next(symbol)) && !ri->IsAtBeginningOf(level));
+
+        lines.push_back(std::move(line));
+    }
+    delete ri;
+    return 1;
+}
+
+int recognize_lines(tesseract::TessBaseAPI* api, Pix* image,
+    tesseract::ETEXT_DESC* monitor, std::vector<TextLine>& lines)
+{
+    api->SetImage(image);
+    int recognized = read_lines(api, monitor, lines);
+    api->Clear();
+    return recognized;
+}
+
+// Recognizes only the header and footer bands of the page. Line boxes
+// still come back in full-page coordinates.
+int recognize_bands(tesseract::TessBaseAPI* api, Pix* image,
+    const SearchOptions& options, tesseract::ETEXT_DESC* monitor,
+    std::vector<TextLine>& lines)
+{
+    int width = pixGetWidth(image);
+    int height = pixGetHeight(image);
+    int top = (int)(height * options.roi_top);
+    int bottom = (int)(height * options.roi_bottom);
+    int recognized = 1;
+
+    api->SetImage(image);
+    if (top + bottom >= height) {
+        recognized = read_lines(api, monitor, lines);
+    } else {
+        if (top > 0) {
+            api->SetRectangle(0, 0, width, top);
+            recognized = read_lines(api, monitor, lines);
+        }
+        if (recognized && bottom > 0) {
+            api->SetRectangle(0, height - bottom, width, bottom);
+            recognized = read_lines(api, monitor, lines);
+        }
+    }
+    api->Clear();
+    return recognized;
+}
+
+void generate_rendered_file_name(
+    const char* base_path, int page_number, std::string& name)
+{
+    name += base_path;
+    name += "_";
+    name += std::to_string(page_number);
+    name += ".jpg";
+}
+
+Pix* load_rendered_file(const char* base_path, int page_number,
+    std::unique_ptr<poppler::document>& doc, const RenderSettings& settings,
+    StageTimings* timings)
+{
+    std::string raster_file_path;
+
+    generate_rendered_file_name(base_path, page_number, raster_file_path);
+
+    if (!convert_pdf_page(
+            doc, page_number, raster_file_path, settings, timings)) {
+        return nullptr;
+    }
+
+    ScopedStage stage(timings, "pixRead");
+    Pix* image = pixRead(raster_file_path.c_str());
+    std::remove(raster_file_path.c_str());
+
+    return image;
+}
+
+int prepare_page(const char* base_path, int page_number,
+    std::unique_ptr<poppler::document>& doc, json& result,
+    const KeywordMatcher& matcher, const SearchOptions& options, Pix** image,
+    StageTimings* timings)
+{
+    *image = nullptr;
+
+    if (options.text_layer) {
+        std::vector<TextLine> lines;
+        int usable;
+        {
+            ScopedStage stage(timings, "textLayer");
+            usable = extract_text_lines(doc, page_number, lines);
+        }
+        if (usable) {
+            std::cerr << "Using text layer of " << base_path
+                      << " (page number " << page_number << ")" << std::endl;
+            ScopedStage stage(timings, "match");
+            search_lines(lines, SOURCE_TEXT_LAYER, matcher, result);
+            result["pageNumber"] = page_number;
+            return 1;
+        }
+    }
+
+    RenderSettings settings;
+    settings.gray = options.gray;
+    if (options.coarse_dpi > 0) {
+        settings.dpi = (int)options.coarse_dpi;
+    }
+    *image = options.render_to_file
+        ? load_rendered_file(base_path, page_number, doc, settings, timings)
+        : render_pdf_page(doc, page_number, settings, timings);
+
+    return *image != nullptr;
+}
+
+// A rectangle of page pixels at RENDER_DPI.
+typedef struct Region {
+    int x1, y1, x2, y2;
+} Region;
+
+// Moves lines recognized in a cropped image at (x, y) into page
+// coordinates.
+void shift_lines(std::vector<TextLine>& from, int x, int y,
+    std::vector<TextLine>& to)
+{
+    for (TextLine& line : from) {
+        line.x1 += x;
+        line.x2 += x;
+        line.y1 += y;
+        line.y2 += y;
+        for (CharBox& box : line.chars) {
+            box.x1 += x;
+            box.x2 += x;
+            box.y1 += y;
+            box.y2 += y;
+        }
+        to.push_back(std::move(line));
+    }
+}
+
+// Height shared by neighbouring strips; a line up to this tall lies whole
+// in at least one of them.
+const int STRIP_OVERLAP = RENDER_DPI / 2;
+const int STRIP_EDGE = 2;
+const double STRIP_DUPLICATE_IOU = 0.5;
+
+void run_strip(tesseract::TessBaseAPI* api, StripJob& job)
+{
+    // Each engine updates its own progress fields; only the owner's
+    // cancel callback is shared.
+    tesseract::ETEXT_DESC monitor;
+    if (job.monitor != nullptr) {
+        monitor.cancel = job.monitor->cancel;
+        monitor.cancel_this = job.monitor->cancel_this;
+    }
+
+    std::vector<TextLine> lines;
+    int recognized = recognize_lines(api, job.image, &monitor, lines);
+    pixDestroy(&job.image);
+    shift_lines(lines, 0, job.y, *job.lines);
+    job.group->done(recognized);
+}
+
+double box_iou(const TextLine& a, const TextLine& b)
+{
+    long width = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
+    long height = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+    long both = width * height;
+    long area_a = (long)(a.x2 - a.x1) * (a.y2 - a.y1);
+    long area_b = (long)(b.x2 - b.x1) * (b.y2 - b.y1);
+    return (double)both / (area_a + area_b - both);
+}
+
+// Drops lines a strip edge inside the page cuts through, then lines that
+// mostly cover one already kept from a strip above.
+void merge_strip_lines(std::vector<std::vector<TextLine> >& strip_lines,
+    const std::vector<Region>& strips, int height,
+    std::vector<TextLine>& lines)
+{
+    for (size_t i = 0; i < strips.size(); i++) {
+        const Region& strip = strips[i];
+        size_t kept = lines.size();
+        for (TextLine& line : strip_lines[i]) {
+            if ((strip.y1 > 0 && line.y1 <= strip.y1 + STRIP_EDGE)
+                || (strip.y2 < height && line.y2 >= strip.y2 - STRIP_EDGE)) {
+                continue;
+            }
+            bool duplicate = false;
+            for (size_t j = 0; j < kept && !duplicate; j++) {
+                duplicate = box_iou(lines[j], line) > STRIP_DUPLICATE_IOU;
+            }
+            if (!duplicate) {
+                lines.push_back(std::move(line));
+            }
+        }
+    }
+}
+
+// Recognizes the page as overlapping strips, queueing all but the first
+// for idle workers. The owner works through the queue too, so the page
+// finishes even when no helper is free.
+int recognize_strips(tesseract::TessBaseAPI* api, Pix* image,
+    tesseract::ETEXT_DESC* monitor, PageStrips* strips,
+    std::vector<TextLine>& lines)
+{
+    int width = pixGetWidth(image);
+    int height = pixGetHeight(image);
+    int count = (int)std::min(
+        strips->strip_count(), (long)(height / (2 * STRIP_OVERLAP)));
+    if (count < 2) {
+        return recognize_lines(api, image, monitor, lines);
+    }
+
+    std::vector<Region> regions;
+    std::vector<std::vector<TextLine> > strip_lines(count);
+    std::vector<StripJob> jobs;
+    StripGroup group(count);
+    for (int i = 0; i < count; i++) {
+        Region region = { 0,
+            std::max(0, height * i / count - STRIP_OVERLAP / 2), width,
+            std::min(height, height * (i + 1) / count + STRIP_OVERLAP / 2) };
+        Box* box = boxCreate(region.x1, region.y1, region.x2 - region.x1,
+            region.y2 - region.y1);
+        Pix* crop = pixClipRectangle(image, box, nullptr);
+        boxDestroy(&box);
+        if (crop == nullptr) {
+            panic();
+        }
+        regions.push_back(region);
+        jobs.push_back({ crop, region.y1, monitor, &strip_lines[i], &group });
+    }
+
+    for (int i = 1; i < count; i++) {
+        if (!strips->jobs.push(jobs[i])) {
+            run_strip(api, jobs[i]);
+        }
+    }
+    run_strip(api, jobs[0]);
+
+    StripJob job;
+    while (!group.finished() && strips->jobs.try_pop(job)) {
+        run_strip(api, job);
+    }
+    if (!group.wait()) {
+        return 0;
+    }
+
+    merge_strip_lines(strip_lines, regions, height, lines);
+    return 1;
+}
+
+// Recognizes other workers' strips until every worker is out of pages.
+void help_with_strips(WorkerArgs* args, tesseract::TessBaseAPI* api)
+{
+    if (args->strips == nullptr) {
+        return;
+    }
+
+    args->strips->worker_done();
+    StripJob job;
+    while (api != nullptr && args->strips->jobs.pop(job)) {
+        run_strip(api, job);
+    }
+}
+
+// Lines of a full-page OCR pass, kept so they can be cached.
+typedef struct RecognizedPage {
+    bool full_page = false;
+    std::vector<TextLine> lines;
+} RecognizedPage;
+
+// Returns 0 when Recognize fails or is cancelled, leaving recognized
+// untouched.
+int recognize_page(tesseract::TessBaseAPI* api, const char* base_path,
+    int page_number, Pix* image, json& result, const KeywordMatcher& matcher,
+    const SearchOptions& options, tesseract::ETEXT_DESC* monitor,
+    PageStrips* strips, RecognizedPage* recognized, StageTimings* timings)
+{
+    std::cerr << "Processing " << base_path << " (page number "
+              << page_number << ")" << std::endl;
+
+    std::vector<TextLine> lines;
+    bool use_bands = options.roi_top + options.roi_bottom > 0;
+    if (use_bands) {
+        {
+            ScopedStage stage(timings, "recognizeBands");
+            if (!recognize_bands(api, image, options, monitor, lines)) {
+                return 0;
+            }
+        }
+        ScopedStage stage(timings, "match");
+        search_lines(lines, SOURCE_OCR, matcher, result);
+    }
+
+    if (!result.contains("found")) {
+        lines.clear();
+        {
+            ScopedStage stage(timings, "recognize");
+            int complete = strips != nullptr
+                ? recognize_strips(api, image, monitor, strips, lines)
+                : recognize_lines(api, image, monitor, lines);
+            if (!complete) {
+                return 0;
+            }
+        }
+        {
+            ScopedStage stage(timings, "match");
+            search_lines(lines, SOURCE_OCR, matcher, result);
+        }
+        if (use_bands) {
+            result["ocrRegion"] = "page";
+        }
+        if (recognized != nullptr) {
+            recognized->full_page = true;
+            recognized->lines = std::move(lines);
+        }
+    } else {
+        result["ocrRegion"] = "bands";
+    }
+    result["pageNumber"] = page_number;
+    return 1;
+}
+
+// Pads each candidate line of the coarse pass, scales it to RENDER_DPI and
+// merges regions that overlap, so no line is recognized twice.
+void candidate_regions(const std::vector<TextLine>& coarse_lines,
+    const CandidateFilter& candidates, Pix* coarse, double scale,
+    std::vector<Region>& regions)
+{
+    int width = (int)(pixGetWidth(coarse) * scale);
+    int height = (int)(pixGetHeight(coarse) * scale);
+
+    for (const TextLine& line : coarse_lines) {
+        if (!candidates.matches(line.text.c_str())) {
+            continue;
+        }
+        int margin = (line.y2 - line.y1) / 2 + 4;
+        Region region = { std::max(0, (int)((line.x1 - margin) * scale)),
+            std::max(0, (int)((line.y1 - margin) * scale)),
+            std::min(width, (int)((line.x2 + margin) * scale)),
+            std::min(height, (int)((line.y2 + margin) * scale)) };
+        if (region.x2 > region.x1 && region.y2 > region.y1) {
+            regions.push_back(region);
+        }
+    }
+
+    std::sort(regions.begin(), regions.end(),
+        [](const Region& a, const Region& b) { return a.y1 < b.y1; });
+    std::vector<Region> merged;
+    for (const Region& region : regions) {
+        if (!merged.empty() && region.y1 < merged.back().y2
+            && region.x1 < merged.back().x2 && merged.back().x1 < region.x2) {
+            Region& last = merged.back();
+            last.x1 = std::min(last.x1, region.x1);
+            last.x2 = std::max(last.x2, region.x2);
+            last.y2 = std::max(last.y2, region.y2);
+        } else {
+            merged.push_back(region);
+        }
+    }
+    regions.swap(merged);
+}
+
+// Recognizes the coarse render, then re-renders and re-recognizes only the
+// lines that may hold a keyword at RENDER_DPI. Reported boxes are in
+// RENDER_DPI page pixels, the same as a single-tier run.
+int refine_page(tesseract::TessBaseAPI* api, const char* base_path,
+    int page_number, std::unique_ptr<poppler::document>& doc, Pix* coarse,
+    json& result, const KeywordMatcher& matcher,
+    const CandidateFilter& candidates, const SearchOptions& options,
+    tesseract::ETEXT_DESC* monitor, StageTimings* timings)
+{
+    std::cerr << "Processing " << base_path << " (page number "
+              << page_number << ") at " << options.coarse_dpi << " dpi"
+              << std::endl;
+
+    std::vector<TextLine> coarse_lines;
+    {
+        ScopedStage stage(timings, "recognizeCoarse");
+        if (!recognize_lines(api, coarse, monitor, coarse_lines)) {
+            return 0;
+        }
+    }
+
+    std::vector<Region> regions;
+    double scale = (double)RENDER_DPI / options.coarse_dpi;
+    candidate_regions(coarse_lines, candidates, coarse, scale, regions);
+
+    RenderSettings settings;
+    settings.gray = options.gray;
+    std::vector<TextLine> lines;
+    for (const Region& region : regions) {
+        settings.x = region.x1;
+        settings.y = region.y1;
+        settings.width = region.x2 - region.x1;
+        settings.height = region.y2 - region.y1;
+        Pix* image = render_pdf_page(doc, page_number, settings, timings);
+        if (image == nullptr) {
+            return 0;
+        }
+
+        std::vector<TextLine> region_lines;
+        int recognized;
+        {
+            ScopedStage stage(timings, "recognize");
+            recognized = recognize_lines(api, image, monitor, region_lines);
+        }
+        pixDestroy(&image);
+        if (!recognized) {
+            return 0;
+        }
+        shift_lines(region_lines, region.x1, region.y1, lines);
+    }
+
+    ScopedStage stage(timings, "match");
+    search_lines(lines, SOURCE_OCR, matcher, result);
+    result["pageNumber"] = page_number;
+    result["refinedRegions"] = regions.size();
+    return 1;
+}
+
+int ocr_page(tesseract::TessBaseAPI* api, const char* base_path,
+    int page_number, std::unique_ptr<poppler::document>& doc, Pix* image,
+    json& result, const KeywordMatcher& matcher,
+    const CandidateFilter* candidates, const SearchOptions& options,
+    tesseract::ETEXT_DESC* monitor, PageStrips* strips,
+    RecognizedPage* recognized, StageTimings* timings)
+{
+    if (options.blank_threshold > 0) {
+        double ink;
+        {
+            ScopedStage stage(timings, "blankCheck");
+            ink = ink_ratio(image);
+        }
+        if (ink >= 0 && ink < options.blank_threshold) {
+            std::cerr << "Skipping blank page " << base_path
+                      << " (page number " << page_number << ")" << std::endl;
+            result["pageNumber"] = page_number;
+            result["blank"] = true;
+            result["inkRatio"] = ink;
+            return 1;
+        }
+    }
+
+    if (options.coarse_dpi > 0 && candidates != nullptr) {
+        return refine_page(api, base_path, page_number, doc, image, result,
+            matcher, *candidates, options, monitor, timings);
+    }
+
+    return recognize_page(api, base_path, page_number, image, result,
+        matcher, options, monitor, strips, recognized, timings);
+}
+
+int process_page(tesseract::TessBaseAPI* api, const char* base_path,
+    int page_number, std::unique_ptr<poppler::document>& doc, json& result,
+    const KeywordMatcher& matcher, const CandidateFilter* candidates,
+    const SearchOptions& options, tesseract::ETEXT_DESC* monitor,
+    PageStrips* strips, RecognizedPage* recognized, StageTimings* timings)
+{
+    Pix* image;
+
+    if (!prepare_page(base_path, page_number, doc, result, matcher, options,
+            &image, timings)) {
+        return 0;
+    }
+
+    int success = 1;
+    if (image != nullptr) {
+        success = ocr_page(api, base_path, page_number, doc, image, result,
+            matcher, candidates, options, monitor, strips, recognized,
+            timings);
+        pixDestroy(&image);
+    }
+
+    return success;
+}
+
+// A line may end in a TAB and the keyword's own maximum edit distance;
+// other keywords get default_distance.
+int load_keywords(char* keyword_file, long default_distance,
+    std::vector<std::string>& keywords, std::vector<int>& distances)
+{
+    std::filesystem::path file_path(keyword_file);
+    std::ifstream file(file_path);
+
+    if (file.is_open()) {
+        std::string line;
+        while (std::getline(file, line)) {
+            long distance = default_distance;
+            size_t tab = line.rfind('\t');
+            if (tab != std::string::npos) {
+                char* end = nullptr;
+                const char* value = line.c_str() + tab + 1;
+                long parsed = strtol(value, &end, 10);
+                if (*value != '\0' && *end == '\0' && parsed >= 0) {
+                    distance = parsed;
+                    line.erase(tab);
+                }
+            }
+            keywords.push_back(line);
+            distances.push_back((int)distance);
+        }
+        file.close();
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+poppler::document* load_document(const Document& document)
+{
+    if (document.size() > (size_t)std::numeric_limits<int>::max()) {
+        std::cerr << "Document is too large to load from memory." << std::endl;
+        return nullptr;
+    }
+
+    return poppler::document::load_from_raw_data(
+        document.data(), (int)document.size());
+}
+
+void* worker_fail(WorkerArgs* args, const char* reason)
+{
+    if (reason != nullptr) {
+        std::cerr << "Worker: " << args->worker_index << " " << reason
+                  << std::endl;
+    }
+    *args->status = Fail;
+    delete args;
+    return nullptr;
+}
+
+// The traineddata file the engines load, or an empty path when neither
+// --tessdata nor TESSDATA_PREFIX names a directory.
+std::filesystem::path engine_model_path(const SearchOptions& options)
+{
+    const char* tessdata = options.tessdata.empty()
+        ? getenv("TESSDATA_PREFIX")
+        : options.tessdata.c_str();
+    if (!tessdata) {
+        return std::filesystem::path();
+    }
+
+    std::string file_name = std::string(ENGINE_LANGUAGE) + ".traineddata";
+    return std::filesystem::path(tessdata) / file_name;
+}
+
+int load_engine_model(const SearchOptions& options, MappedFile& model)
+{
+    std::filesystem::path path = engine_model_path(options);
+    if (path.empty()) {
+        std::cerr << "TESSDATA_PREFIX is not set, each engine will load its "
+                     "own model."
+                  << std::endl;
+        return 0;
+    }
+
+    if (!std::filesystem::exists(path) || !model.open(path.c_str())) {
+        std::cerr << "Unable to map '" << path.string()
+                  << "', each engine will load its own model." << std::endl;
+        return 0;
+    }
+
+    std::cerr << "Mapped " << model.size() << " bytes of model data from '"
+              << path.string() << "'." << std::endl;
+    return 1;
+}
+
+// Identifies the model by its contents when it is mapped, otherwise by the
+// file the engines will load.
+std::string model_settings(
+    const SearchOptions& options, const MappedFile& model)
+{
+    if (model.data() != nullptr) {
+        return OcrCache::fingerprint(model.data(), model.size());
+    }
+
+    std::filesystem::path path = engine_model_path(options);
+    std::error_code error;
+    uintmax_t size = path.empty() ? 0 : std::filesystem::file_size(path, error);
+    return path.string() + "-" + std::to_string(error ? 0 : size);
+}
+
+// Everything besides the document and page that changes what OCR returns.
+std::string cache_settings(
+    const SearchOptions& options, const MappedFile& model)
+{
+    return std::string("tesseract=") + tesseract::TessBaseAPI::Version()
+        + ";lang=" + ENGINE_LANGUAGE + ";dpi=" + std::to_string(RENDER_DPI)
+        + ";gray=" + std::to_string(options.gray)
+        + ";renderToFile=" + std::to_string(options.render_to_file)
+        + ";textLayer=" + std::to_string(options.text_layer)
+        + ";splitPage=" + std::to_string(std::max(1L, options.split_page))
+        + ";model=" + model_settings(options, model);
+}
+
+OcrCache* open_cache(const SearchOptions& options, const MappedFile& model)
+{
+    if (options.cache_dir.empty()) {
+        return nullptr;
+    }
+
+    auto* cache = new OcrCache(options.cache_dir,
+        (uintmax_t)options.cache_size_mb * 1024 * 1024,
+        cache_settings(options, model));
+    if (!cache->open()) {
+        std::cerr << "Continuing without the OCR cache." << std::endl;
+        delete cache;
+        return nullptr;
+    }
+
+    return cache;
+}
+
+void fingerprint_document(const SearchOptions& options, Document& document)
+{
+    if (!options.cache_dir.empty()) {
+        document.fingerprint
+            = OcrCache::fingerprint(document.data(), document.size());
+    }
+}
+
+int init_engine(int worker_index, tesseract::TessBaseAPI& api,
+    const MappedFile* model, StageTimings& timings)
+{
+    {
+        ScopedStage stage(&timings, "init");
+        int status = model && model->data()
+            ? api.Init(model->data(), (int)model->size(), ENGINE_LANGUAGE,
+                tesseract::OEM_DEFAULT, nullptr, 0, nullptr, nullptr, false,
+                nullptr)
+            : api.Init(nullptr, ENGINE_LANGUAGE);
+        if (status != 0) {
+            return 0;
+        }
+    }
+    std::cerr << "Worker: " << worker_index << " initialized engine in "
+              << timings["init"] << " ms" << std::endl;
+    return 1;
+}
+
+int open_job_document(WorkerArgs* args, const PageJob& job, int& current,
+    std::unique_ptr<poppler::document>& doc)
+{
+    if (doc && current == job.document) {
+        return 1;
+    }
+
+    ScopedStage stage(&args->stats->timings, "load");
+    doc.reset(load_document(*args->documents[job.document]));
+    current = job.document;
+    return doc != nullptr;
+}
+
+const char* job_path(WorkerArgs* args, const PageJob& job)
+{
+    return args->documents[job.document]->path.c_str();
+}
+
+int load_cached_page(
+    WorkerArgs* args, const PageJob& job, json& result, StageTimings* timings)
+{
+    if (args->cache == nullptr) {
+        return 0;
+    }
+
+    std::vector<TextLine> lines;
+    {
+        ScopedStage stage(timings, "cacheRead");
+        const std::string& fingerprint
+            = args->documents[job.document]->fingerprint;
+        if (!args->cache->load(fingerprint, job.page_number, lines)) {
+            return 0;
+        }
+    }
+    ScopedStage stage(timings, "match");
+    search_lines(lines, SOURCE_OCR, args->matcher, result);
+    result["pageNumber"] = job.page_number;
+    result["cached"] = true;
+    return 1;
+}
+
+void store_cached_page(WorkerArgs* args, const PageJob& job,
+    const RecognizedPage& recognized, StageTimings* timings)
+{
+    // Lines of a cancelled page may be incomplete.
+    if (args->cache == nullptr || !recognized.full_page
+        || args->early_exit.cancelled(job.document, job.sequence)) {
+        return;
+    }
+
+    ScopedStage stage(timings, "cacheWrite");
+    args->cache->store(args->documents[job.document]->fingerprint,
+        job.page_number, recognized.lines);
+}
+
+void skip_page(WorkerArgs* args, const PageJob& job)
+{
+    args->early_exit.count_skipped();
+    args->results.skip(job.sequence);
+}
+
+void emit_page(WorkerArgs* args, const PageJob& job, json& result,
+    const StageTimings& timings)
+{
+    args->early_exit.record(job.document, job.sequence, result);
+    if (args->early_exit.cancelled(job.document, job.sequence)) {
+        skip_page(args, job);
+        return;
+    }
+
+    if (result.contains("blank")) {
+        args->stats->blank_pages++;
+    }
+    if (args->options.batch) {
+        result["file"] = args->documents[job.document]->path;
+    }
+    if (args->options.timings) {
+        result["timings"] = timings;
+    }
+    ScopedStage stage(&args->stats->timings, "output");
+    args->results.add(job.document, job.sequence, std::move(result));
 }
 
-typedef enum WorkerStatus { Running, Success, Fail } WorkerStatus;
+// Recognition stopped by an early exit is not an error: emit_page drops
+// the page. Any other failure is marked on the page's result.
+int check_processed(
+    WorkerArgs* args, const PageJob& job, int processed, json& result)
+{
+    if (processed || args->early_exit.cancelled(job.document, job.sequence)) {
+        return 1;
+    }
 
-class WorkerArgs {
-public:
-    int worker_index;
-    int start_page;
-    int end_page;
-    std::map<int, json>& results;
-    char* keywords_path;
-    char* pdf_path;
-    WorkerStatus* status;
-    WorkerArgs(int workerIndex, int page_number_start, int page_number_end,
-        int total_workers, std::map<int, json>& results, char* keywordsPath,
-        char* pdfPath, WorkerStatus* status)
-        : worker_index(workerIndex)
-        , start_page(get_start_page_for_worker(
-              workerIndex, page_number_start, page_number_end, total_workers))
-        , end_page(get_end_page_for_worker(
-              workerIndex, page_number_start, page_number_end, total_workers))
-        , results(results)
-        , keywords_path(keywordsPath)
-        , pdf_path(pdfPath)
-        , status(status)
-    {
+    std::cerr << "Worker: " << args->worker_index << " " << PAGE_PROCESS_FAIL
+              << " (" << job_path(args, job) << ", page number "
+              << job.page_number << ")" << std::endl;
+    result["pageNumber"] = job.page_number;
+    result["error"] = PAGE_PROCESS_FAIL;
+    return 0;
+}
+
+int run_page_jobs(WorkerArgs* args, tesseract::TessBaseAPI& api)
+{
+    std::unique_ptr<poppler::document> doc;
+    int current_document = -1;
+
+    PageJob job;
+    while (args->pages.pop(job)) {
+        if (args->early_exit.cancelled(job.document, job.sequence)) {
+            skip_page(args, job);
+            continue;
+        }
+
+        json result = json::object();
+        StageTimings timings;
+        RecognizedPage recognized;
+
+        JobMonitor monitor(args->early_exit, job);
+        auto page_start = std::chrono::steady_clock::now();
+        int processed = load_cached_page(args, job, result, &timings);
+        if (!processed) {
+            if (!open_job_document(args, job, current_document, doc)) {
+                std::cerr << "Worker: " << args->worker_index << " "
+                          << DOCUMENT_OPEN_FAIL << std::endl;
+                return 0;
+            }
+            processed = process_page(&api, job_path(args, job),
+                job.page_number, doc, result, args->matcher, args->candidates,
+                args->options, monitor.get(), args->strips, &recognized,
+                &timings);
+            processed = check_processed(args, job, processed, result);
+            store_cached_page(args, job, recognized, &timings);
+        }
+        std::chrono::duration<double, std::milli> page_time
+            = std::chrono::steady_clock::now() - page_start;
+        args->stats->pages++;
+        args->stats->busy_ms += page_time.count();
+        add_timings(args->stats->timings, timings);
+        emit_page(args, job, result, timings);
+
+        if (!processed) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void* worker_process_page(void* _args)
+{
+    auto* args = (WorkerArgs*)_args;
+    WorkerStatus* status = args->status;
+    *status = Running;
+    std::cerr << "Worker: " << args->worker_index << " started" << std::endl;
+
+    tesseract::TessBaseAPI api;
+    if (!init_engine(
+            args->worker_index, api, args->model, args->stats->timings)) {
+        help_with_strips(args, nullptr);
+        return worker_fail(args, ENGINE_INIT_FAIL);
+    }
+    int processed = run_page_jobs(args, api);
+    help_with_strips(args, &api);
+    if (!processed) {
+        return worker_fail(args, nullptr);
     }
-    static int get_start_page_for_worker(
-        int worker_index, int start_offset, int end_offset, int total_workers);
-    static int get_end_page_for_worker(
-        int worker_index, int start_offset, int end_offset, int total_workers);
+
+    *status = Success;
+    delete args;
+    return nullptr;
+}
+
+class WorkerPool {
+public:
+    WorkerPool(int size, const MappedFile* model, OcrCache* cache);
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool();
+    int start();
+    int run(PageQueue& pages, ResultSink& results,
+        const KeywordMatcher& matcher, const CandidateFilter* candidates,
+        const DocumentList& documents, EarlyExit& early_exit,
+        const SearchOptions& options);
+
+private:
+    typedef struct PoolSlot {
+        WorkerPool* pool;
+        int index;
+        pthread_t thread;
+        bool started;
+        WorkerArgs* args;
+        WorkerStatus status;
+        WorkerStats stats;
+    } PoolSlot;
+    std::vector<PoolSlot> slots;
+    const MappedFile* model;
+    OcrCache* cache;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    long generation = 0;
+    int active = 0;
+    int initialized = 0;
+    int failed = 0;
+    bool shutdown = false;
+    static void* thread_main(void* _slot);
 };
-int WorkerArgs::get_start_page_for_worker(
-    int worker_index, int start_offset, int end_offset, int total_workers)
+
+WorkerPool::WorkerPool(int size, const MappedFile* model, OcrCache* cache)
+    : slots(size)
+    , model(model)
+    , cache(cache)
+{
+    pthread_mutex_init(&lock, nullptr);
+    pthread_cond_init(&changed, nullptr);
+}
+
+WorkerPool::~WorkerPool()
+{
+    pthread_mutex_lock(&lock);
+    shutdown = true;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+
+    for (PoolSlot& slot : slots) {
+        if (slot.started) {
+            pthread_join(slot.thread, nullptr);
+        }
+    }
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&lock);
+}
+
+int WorkerPool::start()
+{
+    for (size_t i = 0; i < slots.size(); i++) {
+        slots[i].pool = this;
+        slots[i].index = (int)i;
+        slots[i].args = nullptr;
+        slots[i].started
+            = pthread_create(&slots[i].thread, nullptr, thread_main, &slots[i])
+            == 0;
+        if (!slots[i].started) {
+            pthread_mutex_lock(&lock);
+            initialized++;
+            failed++;
+            pthread_mutex_unlock(&lock);
+        }
+    }
+
+    pthread_mutex_lock(&lock);
+    while (initialized < (int)slots.size()) {
+        pthread_cond_wait(&changed, &lock);
+    }
+    int ready = failed == 0;
+    pthread_mutex_unlock(&lock);
+
+    return ready;
+}
+
+void* WorkerPool::thread_main(void* _slot)
 {
-    int num_jobs_per_worker = (end_offset - start_offset + 1) / total_workers;
-    return start_offset + (num_jobs_per_worker * worker_index);
+    auto* slot = (PoolSlot*)_slot;
+    WorkerPool* pool = slot->pool;
+    tesseract::TessBaseAPI api;
+    int ready
+        = init_engine(slot->index, api, pool->model, slot->stats.timings);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->initialized++;
+    if (!ready) {
+        pool->failed++;
+    }
+    pthread_cond_broadcast(&pool->changed);
+
+    long seen = 0;
+    while (ready) {
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        seen = pool->generation;
+        WorkerArgs* args = slot->args;
+        pthread_mutex_unlock(&pool->lock);
+
+        *args->status = Running;
+        *args->status = run_page_jobs(args, api) ? Success : Fail;
+
+        pthread_mutex_lock(&pool->lock);
+        pool->active--;
+        pthread_cond_broadcast(&pool->changed);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return nullptr;
 }
 
-int WorkerArgs::get_end_page_for_worker(
-    int worker_index, int start_offset, int end_offset, int total_workers)
+int WorkerPool::run(PageQueue& pages, ResultSink& results,
+    const KeywordMatcher& matcher, const CandidateFilter* candidates,
+    const DocumentList& documents, EarlyExit& early_exit,
+    const SearchOptions& options)
 {
-    int is_last = worker_index == total_workers - 1;
-    return is_last ? end_offset
-                   : (WorkerArgs::get_start_page_for_worker(worker_index + 1,
-                          start_offset, end_offset, total_workers)
-                       - 1);
+    for (PoolSlot& slot : slots) {
+        slot.stats = WorkerStats();
+        slot.args = new WorkerArgs(slot.index, pages, results, matcher,
+            candidates, documents, early_exit, options, nullptr, &slot.status,
+            &slot.stats, model, cache, nullptr);
+    }
+
+    pthread_mutex_lock(&lock);
+    generation++;
+    active = (int)slots.size();
+    pthread_cond_broadcast(&changed);
+    while (active > 0) {
+        pthread_cond_wait(&changed, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+
+    int success = 1;
+    for (PoolSlot& slot : slots) {
+        if (slot.status != Success) {
+            success = 0;
+        }
+        delete slot.args;
+        slot.args = nullptr;
+    }
+
+    return success;
 }
 
-void process_line(tesseract::ResultIterator& ri,
-    tesseract::PageIteratorLevel level, std::vector<std::string>& keywords,
-    json& found_keywords)
+void* worker_render_page(void* _args)
 {
-    const char* scanned_line = ri.GetUTF8Text(level);
-    for (const std::string& keyword : keywords) {
-        const char* found = strstr(scanned_line, keyword.c_str());
-        if (found) {
-            json bbox = json::object();
-            if (!found_keywords.contains(keyword)) {
-                found_keywords[keyword] = json::array();
+    auto* args = (WorkerArgs*)_args;
+    Pipeline* pipeline = args->pipeline;
+    *args->status = Running;
+    std::unique_ptr<poppler::document> doc;
+    int current_document = -1;
+    std::cerr << "Worker: " << args->worker_index << " started rendering"
+              << std::endl;
+
+    PageJob job;
+    while (args->pages.pop(job)) {
+        if (args->early_exit.cancelled(job.document, job.sequence)) {
+            skip_page(args, job);
+            continue;
+        }
+
+        json result = json::object();
+        StageTimings timings;
+        Pix* image = nullptr;
+
+        auto page_start = std::chrono::steady_clock::now();
+        int prepared = load_cached_page(args, job, result, &timings);
+        if (!prepared) {
+            if (!open_job_document(args, job, current_document, doc)) {
+                pipeline->renderer_done();
+                return worker_fail(args, DOCUMENT_OPEN_FAIL);
             }
-            int x1, y1, x2, y2;
-            ri.BoundingBox(level, &x1, &y1, &x2, &y2);
-            bbox["startPos"] = found - scanned_line;
-            bbox["confidence"] = ri.Confidence(level);
-            bbox["xStart"] = x1;
-            bbox["xEnd"] = x2;
-            bbox["yStart"] = y1;
-            bbox["yEnd"] = y2;
-            bbox["text"] = std::string(scanned_line);
-            found_keywords[keyword].push_back(bbox);
+            prepared = prepare_page(job_path(args, job), job.page_number, doc,
+                result, args->matcher, args->options, &image, &timings);
+        }
+        std::chrono::duration<double, std::milli> page_time
+            = std::chrono::steady_clock::now() - page_start;
+        args->stats->pages++;
+        args->stats->busy_ms += page_time.count();
+        add_timings(args->stats->timings, timings);
+
+        if (!prepared) {
+            pipeline->renderer_done();
+            return worker_fail(args, nullptr);
+        } else if (image == nullptr) {
+            emit_page(args, job, result, timings);
+        } else if (!pipeline->rendered.push({ job, image, timings })) {
+            pixDestroy(&image);
+            break;
         }
     }
-    delete[] scanned_line;
+
+    pipeline->renderer_done();
+    *args->status = Success;
+    delete args;
+    return nullptr;
 }
 
-void search_file(std::string& raster_file_path,
-    std::vector<std::string>& keywords, json& result)
+void* worker_recognize_page(void* _args)
 {
-    Pix* image = pixRead(raster_file_path.c_str());
-    auto* api = new tesseract::TessBaseAPI();
-    api->Init(nullptr, "eng");
-    api->SetImage(image);
-    api->Recognize(nullptr);
-    tesseract::ResultIterator* ri = api->GetIterator();
-    tesseract::PageIteratorLevel level = tesseract::RIL_TEXTLINE;
-    if (ri != nullptr) {
-        json found_keywords = json::object();
+    auto* args = (WorkerArgs*)_args;
+    Pipeline* pipeline = args->pipeline;
+    *args->status = Running;
+    std::cerr << "Worker: " << args->worker_index << " started recognizing"
+              << std::endl;
 
-        do {
-            process_line(*ri, level, keywords, found_keywords);
-        } while (ri->Next(level));
+    tesseract::TessBaseAPI api;
+    if (!init_engine(
+            args->worker_index, api, args->model, args->stats->timings)) {
+        pipeline->recognizer_done();
+        help_with_strips(args, nullptr);
+        return worker_fail(args, ENGINE_INIT_FAIL);
+    }
 
-        if (!found_keywords.empty()) {
-            result["found"] = found_keywords;
+    std::unique_ptr<poppler::document> doc;
+    int current_document = -1;
+    int recognized = 1;
+
+    RenderedPage page;
+    while (recognized && pipeline->rendered.pop(page)) {
+        if (args->early_exit.cancelled(page.job.document, page.job.sequence)) {
+            pixDestroy(&page.image);
+            skip_page(args, page.job);
+            continue;
+        } else if (args->options.coarse_dpi > 0
+            && !open_job_document(args, page.job, current_document, doc)) {
+            pixDestroy(&page.image);
+            pipeline->recognizer_done();
+            help_with_strips(args, &api);
+            return worker_fail(args, DOCUMENT_OPEN_FAIL);
         }
+
+        json result = json::object();
+        StageTimings timings;
+        RecognizedPage lines;
+
+        JobMonitor monitor(args->early_exit, page.job);
+        auto page_start = std::chrono::steady_clock::now();
+        recognized = ocr_page(&api, job_path(args, page.job),
+            page.job.page_number, doc, page.image, result, args->matcher,
+            args->candidates, args->options, monitor.get(), args->strips,
+            &lines, &timings);
+        pixDestroy(&page.image);
+        recognized = check_processed(args, page.job, recognized, result);
+        store_cached_page(args, page.job, lines, &timings);
+        std::chrono::duration<double, std::milli> page_time
+            = std::chrono::steady_clock::now() - page_start;
+        args->stats->pages++;
+        args->stats->busy_ms += page_time.count();
+        add_timings(args->stats->timings, timings);
+        add_timings(page.timings, timings);
+        emit_page(args, page.job, result, page.timings);
+    }
+
+    pipeline->recognizer_done();
+    help_with_strips(args, &api);
+    if (!recognized) {
+        return worker_fail(args, nullptr);
     }
-    delete api;
+    *args->status = Success;
+    delete args;
+    return nullptr;
 }
 
-void generate_rendered_file_name(
-    char* base_path, int page_number, std::string& name)
+int load_manifest(const char* manifest, std::vector<std::string>& paths)
 {
-    name += base_path;
-    name += "_";
-    name += std::to_string(page_number);
-    name += ".jpg";
+    std::ifstream file;
+    std::istream* in = &std::cin;
+
+    if (strcmp(manifest, "-") != 0) {
+        file.open(manifest);
+        if (!file.is_open()) {
+            return 0;
+        }
+        in = &file;
+    }
+
+    std::string line;
+    while (std::getline(*in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            paths.push_back(line);
+        }
+    }
+
+    return 1;
 }
 
-int process_page(char* base_path, int page_number,
-    std::unique_ptr<poppler::document>& doc, json& result,
-    std::vector<std::string>& keywords)
+int select_document_pages(Document& document, char* page_range)
 {
-    std::string raster_file_path;
+    std::unique_ptr<poppler::document> doc(load_document(document));
+    if (!doc) {
+        std::cerr << "'" << document.path << "': " << DOCUMENT_OPEN_FAIL
+                  << std::endl;
+        return 0;
+    }
 
-    generate_rendered_file_name(base_path, page_number, raster_file_path);
+    int max_page = doc->pages();
+    if (max_page < 1
+        || !parse_page_range(page_range, document.first_page,
+            document.last_page, max_page)) {
+        std::cerr << "'" << document.path << "': no pages to process."
+                  << std::endl;
+        return 0;
+    }
+
+    std::cerr << "Document '" << document.path << "': pages "
+              << document.first_page << "-" << document.last_page << " of "
+              << max_page << "." << std::endl;
+    return 1;
+}
+
+int open_input_document(
+    const std::string& path, char* page_range, Document& document)
+{
+    document.path = path;
 
-    if (!convert_pdf_page(doc, page_number, raster_file_path)) {
+    if (!std::filesystem::exists(path)) {
+        std::cerr << "Image File '" << path << "' does not exist."
+                  << std::endl;
+        return 0;
+    } else if (!document.file.open(path.c_str())) {
+        std::cerr << DOCUMENT_OPEN_FAIL << std::endl;
         return 0;
     }
 
-    std::cerr << "Processing " << raster_file_path << " (page number "
-              << page_number << ")" << std::endl;
+    return select_document_pages(document, page_range);
+}
 
-    search_file(raster_file_path, keywords, result);
-    result["pageNumber"] = page_number;
+typedef struct ServerContext {
+    WorkerPool& pool;
+    const KeywordMatcher& default_matcher;
+    const CandidateFilter* default_candidates;
+    const SearchOptions& options;
+    std::vector<std::string> cached_keywords;
+    std::unique_ptr<KeywordMatcher> cached_matcher;
+    std::unique_ptr<CandidateFilter> cached_candidates;
+} ServerContext;
 
-    std::remove(raster_file_path.c_str());
+std::string error_response(const std::string& message)
+{
+    json response = { { "error", message } };
+    return response.dump();
+}
 
-    return 1;
+CandidateFilter* build_candidates(
+    const SearchOptions& options, const std::vector<std::string>& keywords)
+{
+    return options.coarse_dpi > 0
+        ? new CandidateFilter(keywords, options.normalize)
+        : nullptr;
 }
 
-int load_keywords(char* keyword_file, std::vector<std::string>& keywords)
+const KeywordMatcher* request_matcher(ServerContext* server,
+    const json& request, const CandidateFilter** candidates)
 {
-    std::filesystem::path file_path(keyword_file);
-    std::ifstream file(file_path);
+    if (!request.contains("keywords")) {
+        *candidates = server->default_candidates;
+        return &server->default_matcher;
+    }
 
-    if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            keywords.push_back(line);
+    std::vector<std::string> keywords
+        = request["keywords"].get<std::vector<std::string> >();
+    if (!server->cached_matcher || keywords != server->cached_keywords) {
+        std::vector<int> distances(
+            keywords.size(), (int)server->options.max_distance);
+        server->cached_matcher.reset(
+            new KeywordMatcher(keywords, distances, server->options.normalize));
+        server->cached_candidates.reset(
+            build_candidates(server->options, keywords));
+        server->cached_keywords = keywords;
+    }
+
+    *candidates = server->cached_candidates.get();
+    return server->cached_matcher.get();
+}
+
+std::string handle_request(const std::string& line, void* context, bool* stop)
+{
+    auto* server = (ServerContext*)context;
+    json request = json::parse(line, nullptr, false);
+    if (request.is_discarded() || !request.is_object()) {
+        return error_response("Malformed request.");
+    }
+
+    try {
+        if (request.value("shutdown", false)) {
+            *stop = true;
+            json response = { { "shutdown", true } };
+            return response.dump();
         }
-        file.close();
+
+        std::unique_ptr<Document> document(new Document());
+        if (request.contains("pdf")) {
+            document->path = request["pdf"].get<std::string>();
+            if (!std::filesystem::exists(document->path)
+                || !document->file.open(document->path.c_str())) {
+                return error_response(DOCUMENT_OPEN_FAIL);
+            }
+        } else if (request.contains("pdfBase64")) {
+            document->path = request.value("name", std::string("<request>"));
+            if (!base64_decode(request["pdfBase64"].get<std::string>(),
+                    document->bytes)
+                || document->bytes.empty()) {
+                return error_response("Invalid pdfBase64 payload.");
+            }
+        } else {
+            return error_response("Request needs \"pdf\" or \"pdfBase64\".");
+        }
+
+        std::string range = request.value("pages", std::string("all"));
+        std::vector<char> page_range(range.begin(), range.end());
+        page_range.push_back('\0');
+        if (!select_document_pages(*document, page_range.data())) {
+            return error_response("Invalid page range or document.");
+        }
+
+        const CandidateFilter* candidates;
+        const KeywordMatcher* matcher
+            = request_matcher(server, request, &candidates);
+        fingerprint_document(server->options, *document);
+        DocumentList documents;
+        documents.push_back(std::move(document));
+        PageQueue pages(documents);
+        std::ostringstream out;
+        EarlyExit early_exit(
+            server->options.exit_mode, 1, matcher->keywords().size());
+        ResultSink results(out, Buffered, false, &early_exit);
+
+        auto run_start = std::chrono::steady_clock::now();
+        int success = server->pool.run(pages, results, *matcher, candidates,
+            documents, early_exit, server->options);
+        results.finish();
+        std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - run_start;
+        std::cerr << "Served '" << documents[0]->path << "' ("
+                  << pages.size() << " pages) in " << elapsed.count()
+                  << " ms" << std::endl;
+
+        return success ? out.str()
+                       : error_response("Failed to process the document.");
+    } catch (const json::exception& ex) {
+        return error_response(ex.what());
+    }
+}
+
+const long AUTO_THREADS = 0;
+
+int parse_thread_count(char* value, long& num_threads)
+{
+    if (strcmp(value, "auto") == 0) {
+        num_threads = AUTO_THREADS;
         return 1;
-    } else {
+    } else if (!(num_threads = strtol(value, nullptr, 10))) {
+        std::cerr << "Invalid thread count '" << value << "'." << std::endl;
         return 0;
     }
+
+    return 1;
 }
 
-void* worker_process_page(void* _args)
+// Sizes the worker pool for an "auto" thread count and num_pages pages.
+// Unless the user set OMP_THREAD_LIMIT, the process restarts itself when
+// the OpenMP budget it started with does not fit the split.
+long auto_thread_count(char** argv, long num_pages, bool can_reexec)
 {
-    auto* args = (WorkerArgs*)_args;
-    WorkerStatus* status = args->status;
-    *status = Running;
+    long cpus = available_cpus();
+    long workers, omp_threads;
+    long user_limit = user_omp_limit();
+
+    if (user_limit > 0) {
+        omp_threads = user_limit;
+        workers = std::max(1L, cpus / omp_threads);
+    } else {
+        split_cpu_budget(cpus, num_pages, workers, omp_threads);
+        if (current_omp_limit() != omp_threads) {
+            if (can_reexec) {
+                reexec_with_omp_limit(argv, omp_threads);
+            } else {
+                std::cerr << "Cannot restart to apply OMP_THREAD_LIMIT="
+                          << omp_threads << " after reading the manifest "
+                          << "from stdin." << std::endl;
+            }
+            omp_threads = current_omp_limit();
+            workers = cpus;
+        }
+    }
+
+    std::cerr << "Auto thread count: " << cpus << " CPUs available, "
+              << workers << " workers, OMP_THREAD_LIMIT="
+              << (omp_threads > 0 ? std::to_string(omp_threads) : "unset")
+              << "." << std::endl;
+    return workers;
+}
+
+int run_server(
+    char** argv, SearchOptions& options, std::vector<char*>& positional)
+{
+    long num_threads = AUTO_THREADS;
+    if (positional.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    } else if (positional.size() >= 2
+        && !parse_thread_count(positional[1], num_threads)) {
+        return 1;
+    }
+
     std::vector<std::string> keywords;
-    std::string pdf_file(args->pdf_path);
-    std::unique_ptr<poppler::document> doc(
-        (poppler::document::load_from_file(pdf_file)));
-    std::cerr << "Worker: " << args->worker_index
-              << " started processing pages: " << args->start_page << "-"
-              << args->end_page << std::endl;
-
-    if (!load_keywords(args->keywords_path, keywords)) {
-        std::cerr << "Worker: " << args->worker_index << " "
-                  << KEYWORDS_OPEN_FAIL << std::endl;
-        *status = Fail;
-        delete args;
-        return nullptr;
-    } else if (!doc) {
-        std::cerr << "Worker: " << args->worker_index << " "
-                  << DOCUMENT_OPEN_FAIL << std::endl;
-        *status = Fail;
-        delete args;
-        return nullptr;
+    std::vector<int> distances;
+    if (!load_keywords(
+            positional[0], options.max_distance, keywords, distances)) {
+        std::cerr << KEYWORDS_OPEN_FAIL << std::endl;
+        return 1;
+    }
+    KeywordMatcher matcher(keywords, distances, options.normalize);
+    std::unique_ptr<CandidateFilter> candidates(
+        build_candidates(options, keywords));
+    if (num_threads == AUTO_THREADS) {
+        num_threads = auto_thread_count(
+            argv, std::numeric_limits<long>::max(), true);
+    } else if (user_omp_limit() == 0 && current_omp_limit() != 1) {
+        reexec_with_omp_limit(argv, 1);
     }
 
-    for (int page_number = args->start_page; page_number <= args->end_page;
-         page_number++) {
-        (args->results)[page_number] = json::object();
+    // Requests are answered one at a time, each spread over the whole pool.
+    options.batch = false;
+    options.render_threads = 0;
+    options.stream = Buffered;
+    if (options.split_page > 1) {
+        std::cerr << "--split-page is ignored in serve mode." << std::endl;
+    }
+    options.split_page = 0;
 
-        if (!process_page(args->pdf_path, page_number, doc,
-                std::ref(args->results[page_number]), keywords)) {
-            *status = Fail;
-            delete args;
-            return nullptr;
-        }
+    MappedFile model;
+    load_engine_model(options, model);
+    std::unique_ptr<OcrCache> cache(open_cache(options, model));
+    WorkerPool pool((int)num_threads, &model, cache.get());
+    if (!pool.start()) {
+        std::cerr << ENGINE_INIT_FAIL << std::endl;
+        return 1;
     }
 
-    *status = Success;
-    delete args;
-    return nullptr;
+    ServerContext context
+        = { pool, matcher, candidates.get(), options, {}, nullptr, nullptr };
+    return serve_unix_socket(options.serve.c_str(), handle_request, &context)
+        ? 0
+        : 1;
 }
 
 int main(int argc, char** argv)
 {
-    long num_threads = 1;
-    if (argc < 4) {
-        std::cerr << "Usage: " << argv[0]
-                  << " <path to file> <path to keywords> <page num>"
-                  << std::endl;
+    long num_threads = AUTO_THREADS;
+    SearchOptions options;
+    std::vector<char*> positional;
+    if (!parse_options(argc, argv, options, positional)) {
+        print_usage(argv[0]);
         return 1;
-    } else if (!std::filesystem::exists(argv[1])) {
-        std::cerr << "Image File '" << argv[1] << "' does not exist."
-                  << std::endl;
+    } else if (!options.serve.empty()) {
+        return run_server(argv, options, positional);
+    } else if (positional.size() < 3) {
+        print_usage(argv[0]);
+        return 1;
+    } else if (!std::filesystem::exists(positional[1])) {
+        std::cerr << "Keywords File '" << positional[1]
+                  << "' does not exist." << std::endl;
         return 1;
-    } else if (!std::filesystem::exists(argv[2])) {
-        std::cerr << "Keywords File '" << argv[2] << "' does not exist."
+    }
+    if (positional.size() >= 4
+        && !parse_thread_count(positional[3], num_threads)) {
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    if (!options.batch) {
+        paths.push_back(positional[0]);
+    } else if (!load_manifest(positional[0], paths)) {
+        std::cerr << "Unable to read manifest '" << positional[0] << "'."
                   << std::endl;
         return 1;
     }
-    if (argc >= 5) {
-        if (!(num_threads = strtol(argv[4], nullptr, 10))) {
-            std::cerr << "Invalid thread count '" << argv[4] << "'."
-                      << std::endl;
-            return 1;
+
+    int exit_status = 0;
+    DocumentList documents;
+    for (const std::string& path : paths) {
+        std::unique_ptr<Document> document(new Document());
+        if (!open_input_document(path, positional[2], *document)) {
+            if (!options.batch) {
+                return 1;
+            }
+            exit_status = 1;
+            continue;
         }
+        documents.push_back(std::move(document));
     }
 
-    std::string pdf_file(argv[1]);
-    std::unique_ptr<poppler::document> doc(
-        (poppler::document::load_from_file(pdf_file)));
-    if (!doc) {
-        std::cerr << DOCUMENT_OPEN_FAIL << std::endl;
+    PageQueue pages(documents);
+    long num_pages = pages.size();
+    if (num_pages == 0) {
+        std::cerr << "No pages to process." << std::endl;
+        ResultSink(std::cout, options.stream, options.batch).finish();
         return 1;
     }
 
-    int page_number_start, page_number_end, max_page;
-    page_number_start = page_number_end = 1;
-    max_page = doc->pages();
-    if (max_page < 1
-        || !parse_page_range(
-            argv[3], page_number_start, page_number_end, max_page)) {
+    // Split pages leave room for one engine per strip.
+    long num_units = num_pages * std::max(1L, options.split_page);
+    bool from_stdin = options.batch && strcmp(positional[0], "-") == 0;
+    if (num_threads == AUTO_THREADS) {
+        num_threads = auto_thread_count(argv, num_units, !from_stdin);
+    } else if (!from_stdin && user_omp_limit() == 0
+        && current_omp_limit() != 1) {
+        // An explicit worker count keeps each engine single threaded.
+        reexec_with_omp_limit(argv, 1);
+    }
+
+    // Everything below runs once, after any re-exec.
+    std::vector<std::string> keywords;
+    std::vector<int> distances;
+    if (!load_keywords(
+            positional[1], options.max_distance, keywords, distances)) {
+        std::cerr << KEYWORDS_OPEN_FAIL << std::endl;
         return 1;
     }
-    long num_pages = page_number_end - page_number_start + 1;
-    num_threads = std::min(num_threads, num_pages);
+    KeywordMatcher matcher(keywords, distances, options.normalize);
+    std::unique_ptr<CandidateFilter> candidates(
+        build_candidates(options, keywords));
+    for (const std::unique_ptr<Document>& document : documents) {
+        fingerprint_document(options, *document);
+    }
+
+    EarlyExit early_exit(
+        options.exit_mode, documents.size(), matcher.keywords().size());
+    ResultSink results(
+        std::cout, options.stream, options.batch, &early_exit);
+
+    MappedFile model;
+    load_engine_model(options, model);
+    std::unique_ptr<OcrCache> cache(open_cache(options, model));
+
+    long num_renderers = 0;
+    std::unique_ptr<Pipeline> pipeline;
+    std::unique_ptr<PageStrips> strips;
 
-    std::cerr << "Using " << num_threads << " threads to process " << num_pages
-              << " pages " << page_number_start << "-" << page_number_end
-              << ". Doc is " << max_page << " pages long." << std::endl;
+    if (options.render_threads > 0) {
+        num_renderers = std::min(options.render_threads, num_pages);
+        long num_recognizers = std::min(
+            options.ocr_threads > 0 ? options.ocr_threads : num_threads,
+            num_units);
+        size_t depth = options.queue_depth > 0 ? options.queue_depth
+                                               : 2 * num_recognizers;
+        pipeline.reset(new Pipeline(
+            depth, (int)num_renderers, (int)num_recognizers));
+        num_threads = num_renderers + num_recognizers;
+        if (options.split_page > 1) {
+            strips.reset(new PageStrips(
+                options.split_page, (int)num_recognizers));
+        }
+
+        std::cerr << "Using " << num_renderers << " render and "
+                  << num_recognizers << " OCR threads (queue depth " << depth
+                  << ") to process " << num_pages << " pages from "
+                  << documents.size() << " documents." << std::endl;
+    } else {
+        num_threads = std::min(num_threads, num_units);
+        if (options.split_page > 1) {
+            strips.reset(new PageStrips(options.split_page, (int)num_threads));
+        }
+
+        std::cerr << "Using " << num_threads << " threads to process "
+                  << num_pages << " pages from " << documents.size()
+                  << " documents." << std::endl;
+    }
 
     std::vector<pthread_t> threads(num_threads, 0);
-    std::vector<std::map<int, json> > thread_results;
     auto* statuses = new WorkerStatus[num_threads];
     if (statuses == nullptr) {
         panic();
     }
 
-    for (int i = 0; i < num_threads; i++) {
-        thread_results.push_back(std::map<int, json>());
-    }
+    std::vector<WorkerStats> stats(num_threads);
+    auto run_start = std::chrono::steady_clock::now();
 
     for (int i = 0; i < num_threads; i++) {
-        auto* args = new WorkerArgs(i, page_number_start, page_number_end,
-            (int)num_threads, std::ref(thread_results[i]), argv[2], argv[1],
-            &statuses[i]);
+        auto* args = new WorkerArgs(i, pages, results, matcher,
+            candidates.get(), documents, early_exit, options, pipeline.get(),
+            &statuses[i], &stats[i], &model, cache.get(), strips.get());
+        void* (*worker)(void*) = worker_process_page;
 
-        pthread_create(&threads[i], nullptr, worker_process_page, args);
+        if (pipeline && i < num_renderers) {
+            stats[i].role = "render";
+            worker = worker_render_page;
+        } else if (pipeline) {
+            stats[i].role = "ocr";
+            worker = worker_recognize_page;
+        }
+
+        pthread_create(&threads[i], nullptr, worker, args);
     }
 
     for (auto tid : threads) {
         pthread_join(tid, nullptr);
     }
 
-    json all_pages_result = json::array();
-    for (const auto& res : thread_results) {
-        for (const auto& page : res) {
-            all_pages_result.push_back(page.second);
+    std::chrono::duration<double, std::milli> makespan
+        = std::chrono::steady_clock::now() - run_start;
+    for (int i = 0; i < num_threads; i++) {
+        std::cerr << "Worker: " << i << " (" << stats[i].role
+                  << ") processed " << stats[i].pages << " pages, busy "
+                  << stats[i].busy_ms << " ms, idle "
+                  << makespan.count() - stats[i].busy_ms << " ms"
+                  << std::endl;
+    }
+    std::cerr << "Makespan " << makespan.count() << " ms" << std::endl;
+    if (options.exit_mode != ScanAll) {
+        std::cerr << "Skipped " << early_exit.skipped_pages()
+                  << " pages after the stop condition was met." << std::endl;
+    }
+    int blank_pages = 0;
+    for (const WorkerStats& worker : stats) {
+        blank_pages += worker.blank_pages;
+    }
+    if (options.blank_threshold > 0) {
+        std::cerr << "Skipped OCR of " << blank_pages << " blank pages."
+                  << std::endl;
+    }
+
+    if (options.timings) {
+        for (int i = 0; i < num_threads; i++) {
+            json report = { { "worker", i }, { "role", stats[i].role },
+                { "pages", stats[i].pages }, { "busyMs", stats[i].busy_ms },
+                { "idleMs", makespan.count() - stats[i].busy_ms },
+                { "timings", stats[i].timings } };
+            std::cerr << report.dump() << std::endl;
         }
     }
 
-    int exit_status = 0;
     for (int i = 0; i < num_threads; i++) {
         if (statuses[i] != Success) {
             exit_status = 1;
@@ -303,7 +2006,23 @@ int main(int argc, char** argv)
         }
     }
 
-    std::cout << all_pages_result;
+    StageTimings finish_timings;
+    {
+        ScopedStage stage(&finish_timings, "output");
+        results.finish();
+    }
+
+    if (options.timings) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        json summary = { { "makespanMs", makespan.count() },
+            { "finalOutputMs", finish_timings["output"] },
+            { "peakRssKb", usage.ru_maxrss },
+            { "skippedPages", early_exit.skipped_pages() },
+            { "blankPages", blank_pages } };
+        std::cerr << summary.dump() << std::endl;
+    }
+
     delete[] statuses;
 
     return exit_status;
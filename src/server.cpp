@@ -0,0 +1,152 @@
+#include "server.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int send_all(int fd, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n
+            = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return 0;
+        }
+        sent += n;
+    }
+
+    return 1;
+}
+
+static void serve_connection(
+    int client, RequestHandler handler, void* context, bool* stop)
+{
+    std::string buffer;
+    size_t scanned = 0;
+    char chunk[65536];
+
+    while (!*stop) {
+        ssize_t n = read(client, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return;
+        }
+        buffer.append(chunk, n);
+
+        size_t pos;
+        while ((pos = buffer.find('\n', scanned)) != std::string::npos) {
+            std::string request = buffer.substr(0, pos);
+            buffer.erase(0, pos + 1);
+            scanned = 0;
+            if (request.empty()) {
+                continue;
+            }
+
+            std::string response = handler(request, context, stop);
+            response += '\n';
+            if (!send_all(client, response) || *stop) {
+                return;
+            }
+        }
+        scanned = buffer.size();
+    }
+}
+
+static bool is_socket(const char* path)
+{
+    struct stat info;
+    return lstat(path, &info) == 0 && S_ISSOCK(info.st_mode);
+}
+
+// Removes a socket left behind by a server that is gone. Anything that is
+// not a socket, or a socket some server still answers on, is left alone.
+static int remove_stale_socket(
+    const char* socket_path, const struct sockaddr_un& addr)
+{
+    struct stat info;
+    if (lstat(socket_path, &info) != 0) {
+        return errno == ENOENT ? 1 : 0;
+    } else if (!S_ISSOCK(info.st_mode)) {
+        std::cerr << "'" << socket_path << "' exists and is not a socket."
+                  << std::endl;
+        return 0;
+    }
+
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) {
+        return 0;
+    }
+    bool live = connect(probe, (const struct sockaddr*)&addr, sizeof(addr))
+        == 0;
+    close(probe);
+    if (live) {
+        std::cerr << "A server is already listening on '" << socket_path
+                  << "'." << std::endl;
+        return 0;
+    }
+
+    unlink(socket_path);
+    return 1;
+}
+
+int serve_unix_socket(
+    const char* socket_path, RequestHandler handler, void* context)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path '" << socket_path << "' is too long."
+                  << std::endl;
+        return 0;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Unable to create socket: " << strerror(errno)
+                  << std::endl;
+        return 0;
+    }
+
+    if (!remove_stale_socket(socket_path, addr)) {
+        close(fd);
+        return 0;
+    }
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || listen(fd, 16) != 0) {
+        std::cerr << "Unable to listen on '" << socket_path
+                  << "': " << strerror(errno) << std::endl;
+        close(fd);
+        return 0;
+    }
+    std::cerr << "Listening on " << socket_path << std::endl;
+
+    bool stop = false;
+    while (!stop) {
+        int client = accept(fd, nullptr, nullptr);
+        if (client < 0 && errno == EINTR) {
+            continue;
+        } else if (client < 0) {
+            std::cerr << "Failed to accept a connection: " << strerror(errno)
+                      << std::endl;
+            break;
+        }
+        serve_connection(client, handler, context, &stop);
+        close(client);
+    }
+
+    close(fd);
+    if (is_socket(socket_path)) {
+        unlink(socket_path);
+    }
+    return stop ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+#ifndef OCR_DEV_SERVER_HPP
+#define OCR_DEV_SERVER_HPP
+#include <string>
+
+// Handles one request line and returns the response line. Setting *stop
+// makes the server exit after the response has been sent.
+typedef std::string (*RequestHandler)(
+    const std::string& request, void* context, bool* stop);
+
+int serve_unix_socket(
+    const char* socket_path, RequestHandler handler, void* context);
+#endif // OCR_DEV_SERVER_HPP
@@ -0,0 +1,27 @@
+#ifndef OCR_DEV_TEXT_LINE_HPP
+#define OCR_DEV_TEXT_LINE_HPP
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Box around the bytes [start, end) of a line's text, usually one
+// character.
+typedef struct CharBox {
+    size_t start;
+    size_t end;
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+} CharBox;
+
+typedef struct TextLine {
+    std::string text;
+    int x1 = 0;
+    int y1 = 0;
+    int x2 = 0;
+    int y2 = 0;
+    float confidence = 0;
+    std::vector<CharBox> chars;
+} TextLine;
+#endif // OCR_DEV_TEXT_LINE_HPP
@@ -0,0 +1,41 @@
+#ifndef OCR_DEV_TIMINGS_HPP
+#define OCR_DEV_TIMINGS_HPP
+#include <chrono>
+#include <map>
+#include <string>
+
+typedef std::map<std::string, double> StageTimings;
+
+// Adds the wall time of its scope, in milliseconds, to one stage.
+class ScopedStage {
+public:
+    ScopedStage(StageTimings* timings, const char* stage)
+        : timings(timings)
+        , stage(stage)
+        , start(std::chrono::steady_clock::now())
+    {
+    }
+    ScopedStage(const ScopedStage&) = delete;
+    ScopedStage& operator=(const ScopedStage&) = delete;
+    ~ScopedStage()
+    {
+        if (timings != nullptr) {
+            std::chrono::duration<double, std::milli> elapsed
+                = std::chrono::steady_clock::now() - start;
+            (*timings)[stage] += elapsed.count();
+        }
+    }
+
+private:
+    StageTimings* timings;
+    const char* stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+inline void add_timings(StageTimings& totals, const StageTimings& timings)
+{
+    for (const auto& stage : timings) {
+        totals[stage.first] += stage.second;
+    }
+}
+#endif // OCR_DEV_TIMINGS_HPP
@@ -1,6 +1,13 @@
+#include "util.h"
+#include <cerrno>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
 char const* ALL_PAGES = "all";
 
@@ -44,3 +51,93 @@ int parse_page_range(char* range, int& start, int& stop, int max_page)
 
     return 1;
 }
+
+static const char BASE64_ALPHABET[]
+    = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void base64_encode(const char* data, size_t size, std::string& out)
+{
+    const auto* bytes = (const unsigned char*)data;
+    out.reserve(out.size() + (size + 2) / 3 * 4);
+
+    for (size_t i = 0; i < size; i += 3) {
+        unsigned int chunk = bytes[i] << 16;
+        if (i + 1 < size) {
+            chunk |= bytes[i + 1] << 8;
+        }
+        if (i + 2 < size) {
+            chunk |= bytes[i + 2];
+        }
+        out += BASE64_ALPHABET[(chunk >> 18) & 0x3f];
+        out += BASE64_ALPHABET[(chunk >> 12) & 0x3f];
+        out += i + 1 < size ? BASE64_ALPHABET[(chunk >> 6) & 0x3f] : '=';
+        out += i + 2 < size ? BASE64_ALPHABET[chunk & 0x3f] : '=';
+    }
+}
+
+int base64_decode(const std::string& in, std::vector<char>& out)
+{
+    int values[256];
+    for (int& value : values) {
+        value = -1;
+    }
+    for (int i = 0; i < 64; i++) {
+        values[(unsigned char)BASE64_ALPHABET[i]] = i;
+    }
+
+    out.reserve(out.size() + in.size() / 4 * 3);
+    unsigned int chunk = 0;
+    int bits = 0;
+    for (unsigned char c : in) {
+        if (c == '=') {
+            break;
+        } else if (values[c] < 0) {
+            return 0;
+        }
+        chunk = (chunk << 6) | values[c];
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back((char)((chunk >> bits) & 0xff));
+        }
+    }
+
+    return 1;
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes != nullptr) {
+        munmap(bytes, length);
+    }
+}
+
+int MappedFile::open(const char* path)
+{
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Unable to open '" << path << "': " << strerror(errno)
+                  << std::endl;
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "Unable to map empty or unreadable file '" << path << "'"
+                  << std::endl;
+        close(fd);
+        return 0;
+    }
+
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Unable to map '" << path << "': " << strerror(errno)
+                  << std::endl;
+        return 0;
+    }
+
+    bytes = (char*)mapped;
+    length = st.st_size;
+    return 1;
+}
@@ -1,4 +1,25 @@
 #ifndef OCR_DEV_UTIL_H
 #define OCR_DEV_UTIL_H
+#include <cstddef>
+#include <string>
+#include <vector>
+
 int parse_page_range(char* range, int& start, int& stop, int max_page);
+void base64_encode(const char* data, size_t size, std::string& out);
+int base64_decode(const std::string& in, std::vector<char>& out);
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+    int open(const char* path);
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    char* bytes = nullptr;
+    size_t length = 0;
+};
 #endif // OCR_DEV_UTIL_H